@@ -0,0 +1,518 @@
+#include "./batched_forward_backward.hpp"
+
+#include <cfloat>
+#include <algorithm>
+#include <utility>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BATCHED_FB_X86 1
+#endif
+
+// kernel se inlinea u ulazne funkcije s target atributom, pa se isti kod
+// prevodi za AVX2 i osnovni skup instrukcija
+#define BATCHED_INLINE inline __attribute__((always_inline))
+
+
+namespace {
+
+/**
+ * Vektor od W double vrijednosti (jedna traka po sekvenci), pripadna maska
+ * usporedbe (-1 / 0 po traci) i isti broj traka u preciznosti latticea (S).
+ * Rekurzije se računaju u double, a pohranjeni lattice je lattice_t.
+ *
+ * Poravnanje je namjerno smanjeno na poravnanje elementa: izvan funkcija s
+ * AVX targetom GCC poravnava ove tipove samo na 16 bajta, pa bi
+ * poravnati pristupi (vmovapd) u kernelu mogli pasti na memoriji iz vectora.
+ */
+template <int W>
+struct Lanes {
+    typedef double V __attribute__((vector_size(W * sizeof(double)), aligned(sizeof(double))));
+    typedef long long I __attribute__((vector_size(W * sizeof(long long)), aligned(sizeof(long long))));
+    typedef lattice_t S __attribute__((vector_size(W * sizeof(lattice_t)), aligned(sizeof(lattice_t))));
+};
+
+
+/**
+ * Kod opažanja u grupi: simbol (0..15) u donja 4 bita, a bitovi 4 i 5 označavaju
+ * dozvoljena stanja 0 i 1. Maske su 0/1, pa se množenje maskom unaprijed uključuje
+ * u tablice po kodu; za maske 0/1 rezultat je jednak množenju u skalarnom kernelu.
+ */
+constexpr int NCODE = 64;
+constexpr uint8_t CODE_SYM = 0x0f;
+constexpr uint8_t CODE_STATE[NSTATE] = {1 << 4, 1 << 5};
+
+struct CodeTables {
+    double P[NSTATE][NSTATE][NCODE];   // A[i][j] * B[j][sym] * m_j
+    double Bm[NSTATE][NCODE];          // B[j][sym] * m_j
+    double start[NSTATE][NCODE];       // pi[i] * B[i][sym] * m_i
+    double mask[NSTATE][NCODE];        // m_j
+    double fallback[NSTATE][NCODE];    // maska normalizirana na 1 (uniformno ako je prazna)
+};
+
+
+CodeTables make_code_tables(const HMM& hmm) {
+    const TransferTable tt = make_transfer_table(hmm);
+    CodeTables tab;
+
+    for (int code = 0; code < NCODE; code++) {
+        int sym = code & CODE_SYM;
+        double m[NSTATE];
+        double msum = 0.0;
+        for (int j = 0; j < NSTATE; j++) {
+            m[j] = (code & CODE_STATE[j]) ? 1.0 : 0.0;
+            msum += m[j];
+        }
+
+        for (int j = 0; j < NSTATE; j++) {
+            for (int i = 0; i < NSTATE; i++) tab.P[i][j][code] = tt.M[sym][i][j] * m[j];
+            tab.Bm[j][code] = hmm.B[j][sym] * m[j];
+            tab.start[j][code] = tt.start[sym][j] * m[j];
+            tab.mask[j][code] = m[j];
+            tab.fallback[j][code] = (msum <= 0.0) ? 1.0 / NSTATE : m[j] / msum;
+        }
+    }
+    return tab;
+}
+
+
+/**
+ * Grupa od W sekvenci s kodovima isprepletenim po trakama: codes[t * W + l].
+ * Trake kraće od T ponavljaju zadnji kod svoje sekvence, a trake bez sekvence
+ * ponavljaju prvu sekvencu grupe; takve trake ne doprinose rezultatu.
+ */
+template <int W>
+struct Batch {
+    int len[W];
+    int T;                     // najveća duljina u grupi
+    vector<uint8_t> codes;
+};
+
+
+template <int W>
+void make_batch(
+    const vector<ObsView>& sequences,
+    const vector<MaskView>& state_masks,
+    const size_t* idx,
+    int n,
+    Batch<W>& b
+) {
+    b.T = 0;
+    for (int l = 0; l < W; l++) {
+        b.len[l] = (int)sequences[idx[l < n ? l : 0]].size();
+        b.T = max(b.T, b.len[l]);
+    }
+    b.codes.resize((size_t)b.T * W);
+
+    for (int l = 0; l < W; l++) {
+        size_t k = idx[l < n ? l : 0];
+        ObsView O = sequences[k];
+        const uint8_t* mask = state_masks[k].empty() ? nullptr : state_masks[k].begin();
+
+        // bitovi maske (MASK_B, MASK_CPG) su upravo bitovi 4 i 5 koda; viši bitovi
+        // (stanja kojih model nema) se odbacuju, kao u mask_allows, da kod ostane < NCODE
+        for (int t = 0; t < b.T; t++) {
+            int s = min(t, b.len[l] - 1);
+            uint8_t bits = mask ? (uint8_t)(mask[s] & MASK_BOTH) : MASK_BOTH;
+            b.codes[(size_t)t * W + l] = O[s] | (uint8_t)(bits << 4);
+        }
+    }
+}
+
+
+/**
+ * Vektor table[codes[l]] po trakama (gradi se u registrima).
+ */
+template <int W, size_t... L>
+BATCHED_INLINE void lookup(typename Lanes<W>::V& out, const double* table, const uint8_t* codes, index_sequence<L...>) {
+    out = (typename Lanes<W>::V){table[codes[L]]...};
+}
+
+template <int W>
+BATCHED_INLINE void lookup(typename Lanes<W>::V& out, const double* table, const uint8_t* codes) {
+    lookup<W>(out, table, codes, make_index_sequence<W>());
+}
+
+
+/**
+ * x ako je test konačan i >= 0, inače 0 (kao provjere isfinite u skalarnoj verziji).
+ *
+ * Uvjeti se pišu izravno u ternarnom operatoru: spremljena maska usporedbe
+ * (npr. I ok = (a > 0) & (b > 0)) GCC često prevodi skalarno.
+ */
+template <int W>
+BATCHED_INLINE void keep_if_valid(typename Lanes<W>::V& x, const typename Lanes<W>::V& test) {
+    const typename Lanes<W>::V zero = {};
+    x = (test >= 0.0) ? ((test <= DBL_MAX) ? x : zero) : zero;
+}
+
+
+/**
+ * Normalizacija kao u skalarnom kernelu (forward_backward.cpp), po trakama:
+ * ako suma nije pozitivna i konačna, alpha je maska normalizirana na 1, a c = 1.
+ */
+template <int W>
+BATCHED_INLINE void normalize(
+    typename Lanes<W>::V& a0,
+    typename Lanes<W>::V& a1,
+    typename Lanes<W>::V& ct,
+    const CodeTables& tab,
+    const uint8_t* codes
+) {
+    typedef typename Lanes<W>::V V;
+
+    const V zero = {};
+    const V one = zero + 1.0;
+
+    V sum = a0 + a1;
+    V bad = (sum > 0.0) ? ((sum <= DBL_MAX) ? zero : one) : one;
+    ct = 1.0 / sum;
+    ct = (ct > scale_limit<lattice_t>()) ? zero + scale_limit<lattice_t>() : ct;
+    a0 *= ct;
+    a1 *= ct;
+
+    double any_bad = 0.0;
+    for (int l = 0; l < W; l++) any_bad += bad[l];
+    if (__builtin_expect(any_bad != 0.0, 0)) {
+        V f0, f1;
+        lookup<W>(f0, tab.fallback[0], codes);
+        lookup<W>(f1, tab.fallback[1], codes);
+        a0 = (bad != 0.0) ? f0 : a0;
+        a1 = (bad != 0.0) ? f1 : a1;
+        ct = (bad != 0.0) ? one : ct;
+    }
+}
+
+
+/**
+ * Forward po trakama; pohranjuje alpha i c te vraća log-vjerojatnost po traci.
+ */
+template <int W>
+BATCHED_INLINE void forward_batch(
+    const Batch<W>& b,
+    const CodeTables& tab,
+    typename Lanes<W>::S* alpha,
+    typename Lanes<W>::S* c,
+    double* ll
+) {
+    typedef typename Lanes<W>::V V;
+    typedef typename Lanes<W>::I I;
+    typedef typename Lanes<W>::S S;
+
+    I last;
+    for (int l = 0; l < W; l++) last[l] = b.len[l] - 1;
+
+    // LogScaleAccumulator po trakama: mantisa u [1, 2) i zbroj eksponenata
+    const I exp_mask = (I){} + (long long)(0x7ffULL << 52);
+    const I exp_bias = (I){} + (long long)(1023ULL << 52);
+    V mantissa = (V){} + 1.0;
+    I exponent = {};
+
+    V a0, a1;
+    const uint8_t* codes = b.codes.data();
+    lookup<W>(a0, tab.start[0], codes);
+    lookup<W>(a1, tab.start[1], codes);
+
+    for (int t = 0; t < b.T; t++, codes += W) {
+        if (t > 0) {
+            V P00, P01, P10, P11;
+            lookup<W>(P00, tab.P[0][0], codes);
+            lookup<W>(P01, tab.P[0][1], codes);
+            lookup<W>(P10, tab.P[1][0], codes);
+            lookup<W>(P11, tab.P[1][1], codes);
+            V n0 = a0 * P00 + a1 * P10;
+            V n1 = a0 * P01 + a1 * P11;
+            a0 = n0;
+            a1 = n1;
+        }
+        V ct;
+        normalize<W>(a0, a1, ct, tab, codes);
+
+        alpha[2 * (size_t)t] = __builtin_convertvector(a0, S);
+        alpha[2 * (size_t)t + 1] = __builtin_convertvector(a1, S);
+        c[t] = __builtin_convertvector(ct, S);
+
+        I tv = (I){} + t;
+        V p = mantissa * ((tv <= last) ? ct : (V){} + 1.0);
+        I bits = (I)p;
+        exponent += ((bits & exp_mask) >> 52) - 1023;
+        mantissa = (V)((bits & ~exp_mask) | exp_bias);
+    }
+
+    for (int l = 0; l < W; l++) {
+        LogScaleAccumulator acc;
+        acc.mantissa = mantissa[l];
+        acc.exponent = exponent[l];
+        ll[l] = -acc.log();
+    }
+}
+
+
+/**
+ * Backward po trakama uz istovremenu akumulaciju očekivanih brojeva (kao
+ * baum_welch_iteration_multi_masked, ali t ide unatrag). beta[t+1] se drži
+ * samo u registrima.
+ */
+template <int W>
+BATCHED_INLINE void backward_counts_batch(
+    const Batch<W>& b,
+    const CodeTables& tab,
+    const HMM& hmm,
+    const typename Lanes<W>::S* alpha,
+    const typename Lanes<W>::S* c,
+    ExpectedCounts* lane_counts
+) {
+    typedef typename Lanes<W>::V V;
+    typedef typename Lanes<W>::I I;
+
+    I last;
+    for (int l = 0; l < W; l++) last[l] = b.len[l] - 1;
+
+    V A_num[NSTATE][NSTATE] = {};
+    V A_den[NSTATE] = {};
+    V B_den[NSTATE] = {};
+
+    const V zero = {};
+    const V tiny = zero + 1e-300;
+
+    // beta[t+1] i produkti koda t+1
+    V b0 = zero, b1 = zero;
+    V P00 = zero, P01 = zero, P10 = zero, P11 = zero, Bm0 = zero, Bm1 = zero;
+
+    for (int t = b.T - 1; t >= 0; t--) {
+        const uint8_t* codes = b.codes.data() + (size_t)t * W;
+
+        // tv >= last: t == len - 1 (ili nadopuna), tv <= last: t unutar sekvence,
+        // tv < last: postoji prijelaz t -> t+1
+        I tv = (I){} + t;
+
+        // beta[t]: na kraju sekvence c[t] * m, inače rekurzija preko koda t+1
+        V ct = __builtin_convertvector(c[t], V);
+        V m0, m1;
+        lookup<W>(m0, tab.mask[0], codes);
+        lookup<W>(m1, tab.mask[1], codes);
+        V r0 = (P00 * b0 + P01 * b1) * ct;
+        V r1 = (P10 * b0 + P11 * b1) * ct;
+        V bt0 = (tv >= last) ? ct * m0 : r0;
+        V bt1 = (tv >= last) ? ct * m1 : r1;
+
+        V a[NSTATE] = {__builtin_convertvector(alpha[2 * (size_t)t], V),
+                       __builtin_convertvector(alpha[2 * (size_t)t + 1], V)};
+        V bt[NSTATE] = {bt0, bt1};
+        V Bn[NSTATE] = {Bm0, Bm1};
+        V bn[NSTATE] = {b0, b1};
+
+        V xi_term[NSTATE][NSTATE];
+        V xi_den = zero;
+        for (int i = 0; i < NSTATE; i++) {
+            for (int j = 0; j < NSTATE; j++) {
+                xi_term[i][j] = a[i] * hmm.A[i][j] * Bn[j] * bn[j];
+                xi_den += xi_term[i][j];
+            }
+        }
+        V gamma_den = a[0] * bt0 + a[1] * bt1;
+
+        xi_den = (xi_den > 0.0) ? ((xi_den <= DBL_MAX) ? xi_den : tiny) : tiny;
+        gamma_den = (gamma_den > 0.0) ? ((gamma_den <= DBL_MAX) ? gamma_den : tiny) : tiny;
+
+        for (int i = 0; i < NSTATE; i++) {
+            // gamma i xi koji nisu konačni ili su negativni se preskaču (dodaje se 0)
+            V gamma = (a[i] * bt[i]) / gamma_den;
+            V g = gamma;
+            keep_if_valid<W>(g, gamma);
+
+            V gb = (tv <= last) ? g : zero;
+            A_den[i] += (tv < last) ? g : zero;
+            B_den[i] += gb;
+            for (int l = 0; l < W; l++) lane_counts[l].B_num[i][codes[l] & CODE_SYM] += gb[l];
+
+            for (int j = 0; j < NSTATE; j++) {
+                V xi = xi_term[i][j] / xi_den;
+                keep_if_valid<W>(xi, xi);
+                keep_if_valid<W>(xi, gamma);
+                A_num[i][j] += (tv < last) ? xi : zero;
+            }
+        }
+
+        lookup<W>(P00, tab.P[0][0], codes);
+        lookup<W>(P01, tab.P[0][1], codes);
+        lookup<W>(P10, tab.P[1][0], codes);
+        lookup<W>(P11, tab.P[1][1], codes);
+        lookup<W>(Bm0, tab.Bm[0], codes);
+        lookup<W>(Bm1, tab.Bm[1], codes);
+        b0 = bt0;
+        b1 = bt1;
+    }
+
+    for (int l = 0; l < W; l++) {
+        for (int i = 0; i < NSTATE; i++) {
+            for (int j = 0; j < NSTATE; j++) lane_counts[l].A_num[i][j] += A_num[i][j][l];
+            lane_counts[l].A_den[i] += A_den[i][l];
+            lane_counts[l].B_den[i] += B_den[i][l];
+        }
+    }
+}
+
+
+/**
+ * Radni prostor dretve za E-korak grupe: kodovi i lattice grupe ponovno se
+ * koriste za sljedeću grupu koju ista dretva preuzme.
+ */
+template <int W>
+struct GroupWorkspace {
+    Batch<W> b;
+    vector<lattice_t> alpha;   // alpha[t] = (alpha0, alpha1), po W traka
+    vector<lattice_t> c;
+};
+
+
+/**
+ * E-korak jedne grupe od n <= W sekvenci (indeksi idx). Brojevi i
+ * log-vjerojatnost svake korištene sekvence k upisuju se u seq_counts[k] i
+ * seq_ll[k]; preskočene sekvence ostaju nule.
+ */
+template <int W>
+BATCHED_INLINE void run_expected_counts_group(
+    const vector<ObsView>& sequences,
+    const vector<MaskView>& state_masks,
+    const CodeTables& tab,
+    const HMM& hmm,
+    const size_t* idx,
+    int n,
+    ExpectedCounts* seq_counts,
+    double* seq_ll
+) {
+    typedef typename Lanes<W>::S S;
+
+    static thread_local GroupWorkspace<W> ws;
+    Batch<W>& b = ws.b;
+    make_batch(sequences, state_masks, idx, n, b);
+    if (ws.c.size() < (size_t)b.T * W) {
+        ws.alpha.resize(2 * (size_t)b.T * W);
+        ws.c.resize((size_t)b.T * W);
+    }
+    S* alpha_v = reinterpret_cast<S*>(ws.alpha.data());
+    S* c_v = reinterpret_cast<S*>(ws.c.data());
+
+    double lane_ll[W];
+    forward_batch(b, tab, alpha_v, c_v, lane_ll);
+
+    ExpectedCounts lane_counts[W];
+    backward_counts_batch(b, tab, hmm, alpha_v, c_v, lane_counts);
+
+    for (int l = 0; l < n; l++) {
+        if (!isfinite(lane_ll[l])) continue;
+        lane_counts[l].used_sequences = 1;
+        seq_counts[idx[l]] = lane_counts[l];
+        seq_ll[idx[l]] = lane_ll[l];
+    }
+}
+
+
+typedef void (*ExpectedCountsGroupFn)(const vector<ObsView>&, const vector<MaskView>&, const CodeTables&,
+                                      const HMM&, const size_t*, int, ExpectedCounts*, double*);
+
+
+#ifdef BATCHED_FB_X86
+
+__attribute__((target("avx2")))
+void expected_counts_group_avx2(const vector<ObsView>& sequences, const vector<MaskView>& state_masks,
+                                const CodeTables& tab, const HMM& hmm, const size_t* idx, int n,
+                                ExpectedCounts* seq_counts, double* seq_ll) {
+    run_expected_counts_group<4>(sequences, state_masks, tab, hmm, idx, n, seq_counts, seq_ll);
+}
+
+#endif
+
+
+void expected_counts_group_generic(const vector<ObsView>& sequences, const vector<MaskView>& state_masks,
+                                   const CodeTables& tab, const HMM& hmm, const size_t* idx, int n,
+                                   ExpectedCounts* seq_counts, double* seq_ll) {
+    run_expected_counts_group<2>(sequences, state_masks, tab, hmm, idx, n, seq_counts, seq_ll);
+}
+
+
+// jedna sekvenca: prazne trake bi samo usporavale
+void expected_counts_group_single(const vector<ObsView>& sequences, const vector<MaskView>& state_masks,
+                                  const CodeTables& tab, const HMM& hmm, const size_t* idx, int n,
+                                  ExpectedCounts* seq_counts, double* seq_ll) {
+    run_expected_counts_group<1>(sequences, state_masks, tab, hmm, idx, n, seq_counts, seq_ll);
+}
+
+
+/**
+ * Široki kernel se koristi tek kad ima dovoljno sekvenci da popuni trake.
+ * AVX-512 (8 traka) nije uključen: GCC ga za ovaj kernel prevodi lošije od
+ * AVX2 i mjereno je bio sporiji.
+ */
+struct Implementation {
+    ExpectedCountsGroupFn expected_counts_group;
+    int lanes;
+};
+
+
+Implementation select_implementation() {
+#ifdef BATCHED_FB_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return {expected_counts_group_avx2, 4};
+#endif
+    return {expected_counts_group_generic, 2};
+}
+
+
+const Implementation& implementation() {
+    static const Implementation impl = select_implementation();
+    return impl;
+}
+
+} // namespace
+
+
+void expected_counts_batched(
+    const vector<ObsView>& sequences,
+    const vector<MaskView>& state_masks,
+    const HMM& hmm,
+    ExpectedCounts& counts,
+    double& ll,
+    ThreadPool* pool
+) {
+    // najdulje sekvence prve: grupe imaju slične duljine (manje nadopune),
+    // a dretve na kraju preuzimaju kraće grupe
+    vector<size_t> order;
+    for (size_t k = 0; k < sequences.size(); k++) {
+        if (sequences[k].size() >= 2) order.push_back(k);
+    }
+    if (order.empty()) return;
+    stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return sequences[a].size() > sequences[b].size();
+    });
+
+    ExpectedCountsGroupFn group_fn = implementation().expected_counts_group;
+    int lanes = implementation().lanes;
+    if (order.size() == 1) {
+        group_fn = expected_counts_group_single;
+        lanes = 1;
+    } else if (order.size() <= 2) {
+        group_fn = expected_counts_group_generic;
+        lanes = 2;
+    }
+
+    const CodeTables tab = make_code_tables(hmm);
+    vector<ExpectedCounts> seq_counts(sequences.size());
+    vector<double> seq_ll(sequences.size(), 0.0);
+
+    const size_t groups = (order.size() + lanes - 1) / lanes;
+    auto run_group = [&](size_t g) {
+        size_t first = g * lanes;
+        int n = (int)min((size_t)lanes, order.size() - first);
+        group_fn(sequences, state_masks, tab, hmm, &order[first], n, seq_counts.data(), seq_ll.data());
+    };
+    if (pool && pool->size() > 1 && groups > 1) {
+        pool->parallel_for(groups, run_group);
+    } else {
+        for (size_t g = 0; g < groups; g++) run_group(g);
+    }
+
+    pairwise_reduce<NSTATE, NSYM>(seq_counts, seq_ll);
+    counts.add(seq_counts[0]);
+    ll += seq_ll[0];
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include <array>
+
+#include "../utils/structs_consts_functions.hpp"
+#include "./forward_backward.hpp"
+#include "./hmm_engine.hpp"
+#include "../utils/thread_pool.hpp"
+
+using namespace std;
+
+
+/**
+ * Očekivani brojevi prijelaza i emisija (E-korak Baum-Welch algoritma) CpG modela.
+ */
+typedef ExpectedCountsT<NSTATE, NSYM> ExpectedCounts;
+
+
+/**
+ * @brief E-korak Baum-Welch algoritma za skup sekvenci uz maske dozvoljenih stanja.
+ *
+ * Sekvence se obrađuju u grupama, po jedna sekvenca u svakoj SIMD traci
+ * (AVX2: 4, inače 2 trake; jedna sekvenca ide sama), s opažanjima i latticeom isprepletenim
+ * po trakama. Kraće sekvence u grupi se nadopunjuju, a trake izvan svoje
+ * sekvence ne doprinose brojevima. Backward prolaz odmah akumulira očekivane
+ * brojeve pa se beta ne pohranjuje.
+ *
+ * Uz pool se grupe (najdulje sekvence prve) dinamički raspoređuju po dretvama,
+ * a svaka dretva ima svoj radni prostor (lattice grupe). Brojevi i
+ * log-vjerojatnost skupljaju se zasebno za svaku sekvencu i zbrajaju u fiksnom
+ * stablu parova po indeksu sekvence, pa je rezultat bitovno isti za bilo koji
+ * broj traka i dretvi (i bez poola). Sekvence kraće od 2 ili s
+ * log-vjerojatnošću koja nije konačna se preskaču.
+ *
+ * @param sequences Vektor sekvenci opažanja (dinukleotidi)
+ * @param state_masks Vektor maski dozvoljenih stanja (bit po stanju) za svaku sekvencu
+ * @param hmm HMM parametri
+ * @param counts Očekivani brojevi (dodaju se na postojeće)
+ * @param ll Log-vjerojatnost (dodaju se log-vjerojatnosti korištenih sekvenci)
+ * @param pool Ako nije nullptr, grupe sekvenci se obrađuju paralelno
+ */
+void expected_counts_batched(
+    const vector<ObsView>& sequences,
+    const vector<MaskView>& state_masks,
+    const HMM& hmm,
+    ExpectedCounts& counts,
+    double& ll,
+    ThreadPool* pool = nullptr
+);
+
@@ -2,6 +2,10 @@
 
 #include "../utils/structs_consts_functions.hpp"
 #include "../algorithms/forward_backward.hpp"
+#include "../algorithms/batched_forward_backward.hpp"
+#include "../algorithms/parallel_scan.hpp"
+#include "../algorithms/hmm_engine.hpp"
+#include "../algorithms/forward_only_counts.hpp"
 
 using namespace std;
 
@@ -11,15 +15,27 @@ using namespace std;
  * uz korištenje maski dozvoljenih stanja po t.
  *
  * @param sequences Vektor sekvenci opažanja (dinukleotidi)
- * @param state_masks Vektor maski dozvoljenih stanja (0/1) za svaku sekvencu
+ * @param state_masks Vektor maski dozvoljenih stanja (bit po stanju) za svaku sekvencu
  * @param hmm HMM model čiji se parametri ažuriraju
  * @param ll Referenca na log-vjerojatnost koja se ažurira
+ * @param scan_pool Ako nije nullptr, E-korak koristi paralelni scan po vremenu
+ *        (expected_counts_parallel); inače se poziva hmm_baum_welch_iteration
+ *        (za CpG model E-korak u SIMD grupama sekvenci)
+ * @param pool Ako nije nullptr (i scan_pool je nullptr), SIMD grupe sekvenci
+ *        E-koraka obrađuju se paralelno (expected_counts_batched); rezultat je
+ *        isti kao serijski
+ * @param forward_only Ako je true, E-korak se računa samo forward prolazom
+ *        (expected_counts_forward_only, memorija ne ovisi o duljini sekvenci);
+ *        sekvence se raspoređuju po dretvama poola, a scan_pool se ne koristi
  *
  * @return double Ažurirana log-vjerojatnost svih sekvenci
  */
 double baum_welch_iteration_multi_masked(
-    const vector<vector<int>>& sequences,
-    const vector<vector<array<double, NSTATE>>>& state_masks,
+    const vector<ObsView>& sequences,
+    const vector<MaskView>& state_masks,
     HMM& hmm,
-    double& ll
+    double& ll,
+    ThreadPool* scan_pool = nullptr,
+    ThreadPool* pool = nullptr,
+    bool forward_only = false
 );
@@ -1,22 +1,24 @@
 #include "./decode.hpp"
+#include "./two_state_kernel.hpp"
 #include "../postprocesing/decoded_postprocesing.hpp"
 
 
-vector<double> compute_posterior_c(const vector<int>& Oseg, const HMM& hmm) {
-    vector<array<double, NSTATE>> alpha, beta;
-    vector<double> c;
+template <class Real>
+vector<Real> compute_posterior_c(ObsView Oseg, const HMM& hmm) {
+    vector<array<Real, NSTATE>> alpha, beta;
+    vector<Real> c;
 
     forward_scaled(Oseg, hmm, alpha, c);
     backward_scaled(Oseg, hmm, c, beta);
 
-    vector<double> posterior(Oseg.size(), 0.0);
+    vector<Real> posterior(Oseg.size(), 0);
     
     for (size_t t = 0; t < Oseg.size(); t++) {
-        double norm = 0.0;
+        Real norm = 0;
         for (int i = 0; i < NSTATE; i++) {
             norm += alpha[t][i] * beta[t][i];
         }
-        if (norm > 0.0) {
+        if (norm > 0) {
             posterior[t] = (alpha[t][1] * beta[t][1]) / norm;
         }
     }
@@ -25,7 +27,8 @@ vector<double> compute_posterior_c(const vector<int>& Oseg, const HMM& hmm) {
 }
 
 
-vector<int> decode_hysteresis(const vector<double>& posterior_c, double enter_th, double exit_th) {
+template <class Real>
+vector<int> decode_hysteresis(const vector<Real>& posterior_c, double enter_th, double exit_th) {
     vector<int> states(posterior_c.size(), 0);
     bool in_cpg = false;
 
@@ -42,10 +45,16 @@ vector<int> decode_hysteresis(const vector<double>& posterior_c, double enter_th
 }
 
 
-vector<CpgRegion> process_window(
-    const vector<int>& O,
-    const string& sequence,
-    const HMM& hmm,
+template vector<float> compute_posterior_c<float>(ObsView, const HMM&);
+template vector<double> compute_posterior_c<double>(ObsView, const HMM&);
+template vector<int> decode_hysteresis<float>(const vector<float>&, double, double);
+template vector<int> decode_hysteresis<double>(const vector<double>&, double, double);
+
+
+template <class Real>
+vector<CpgRegion> islands_from_posterior(
+    const vector<Real>& posterior,
+    const PackedSequence& sequence,
     int start_d,
     int end_d,
     int T,
@@ -54,10 +63,7 @@ vector<CpgRegion> process_window(
     double POST_TRIM, 
     int OVERLAP
 ) {
-    vector<int> Oseg(O.begin() + start_d, O.begin() + end_d);
-
-    auto posterior = compute_posterior_c(Oseg, hmm);
-    auto states    = decode_hysteresis(posterior, POST_ENTER, POST_EXIT);
+    auto states = decode_hysteresis(posterior, POST_ENTER, POST_EXIT);
 
     vector<CpgRegion> islands;
     extract_cpg_islands(islands, states);
@@ -77,9 +83,247 @@ vector<CpgRegion> process_window(
     filter_lenght_and_merge_close_islands(islands);
     filter_by_content(sequence, islands);
 
-    cout << "Window " << start_d << "-" << end_d
-         << " (bp keep " << keep_left_d + 1 << "-" << keep_right_d + 1
-         << "), islands=" << islands.size() << "\n";
+    return islands;
+}
+
+template vector<CpgRegion> islands_from_posterior<float>(const vector<float>&, const PackedSequence&,
+                                                        int, int, int, double, double, double, int);
+template vector<CpgRegion> islands_from_posterior<double>(const vector<double>&, const PackedSequence&,
+                                                         int, int, int, double, double, double, int);
+
+
+namespace {
+
+/**
+ * Otok koji se gradi tijekom spojenog dekodiranja: prvi i zadnji lokalni
+ * indeks unutar intervala zadržavanja s posteriorom >= praga trima.
+ */
+struct OpenIsland {
+    int first = -1;
+    int last = -1;
+
+    void close(vector<CpgRegion>& islands, int start_d) {
+        // isti rezultat kao extract_cpg_islands + pomak + keep_and_clip + trim
+        if (first >= 0) islands.push_back({first + 1 + start_d, last + 2 + start_d, 0});
+        first = last = -1;
+    }
+};
+
+} // namespace
+
+
+template <class Real>
+vector<CpgRegion> decode_islands_fused(
+    ObsView Oseg,
+    const HMM& hmm,
+    int start_d,
+    int keep_left_d,
+    int keep_right_d,
+    double POST_ENTER,
+    double POST_EXIT,
+    double POST_TRIM,
+    size_t memory_budget
+) {
+    const RealTable<Real> tt(make_transfer_table(hmm));
+    const NoMask mask;
+
+    vector<CpgRegion> islands;
+    int L = (int)Oseg.size();
+    if (L == 0) return islands;
+
+    // beta se normalizira po koraku (neovisno o c iz forwarda); posterior je
+    // omjer pa skala po t ne utječe na rezultat
+    const int K = (memory_budget > 0) ? checkpoint_interval(L, NSTATE * sizeof(Real), memory_budget) : L;
+    const int nseg = (L + K - 1) / K;
+
+    // beta na kraju svakog segmenta
+    vector<array<Real, NSTATE>> checkpoints(nseg);
+    Real b0 = 1, b1 = 1;
+    normalize(mask, L - 1, b0, b1);
+    checkpoints[nseg - 1] = {b0, b1};
+    for (int t = L - 2; t >= K - 1; t--) {
+        backward_step(Oseg, tt, mask, t, (Real)1, b0, b1);
+        normalize(mask, t, b0, b1);
+        if (t % K == K - 1) checkpoints[t / K] = {b0, b1};
+    }
+
+    // lokalni interval zadržavanja (rubovi preklapanja se odbacuju)
+    const int keep_lo = keep_left_d - start_d;
+    const int keep_hi = keep_right_d - start_d - 1;
+
+    // radni prostor dretve: beta segmenta se ponovno koristi između prozora
+    static thread_local vector<array<Real, NSTATE>> beta;
+    beta.resize(K);
+    OpenIsland open;
+    bool in_cpg = false;
+    Real a0 = 0, a1 = 0;
+
+    for (int seg = 0; seg < nseg; seg++) {
+        int s = seg * K;
+        int e = min(L, s + K);
+
+        b0 = checkpoints[seg][0];
+        b1 = checkpoints[seg][1];
+        beta[e - 1 - s] = {b0, b1};
+        for (int t = e - 2; t >= s; t--) {
+            backward_step(Oseg, tt, mask, t, (Real)1, b0, b1);
+            normalize(mask, t, b0, b1);
+            beta[t - s] = {b0, b1};
+        }
+
+        for (int t = s; t < e; t++) {
+            if (t == 0) {
+                forward_start(Oseg, tt, mask, a0, a1);
+            } else {
+                forward_step(Oseg, tt, mask, t, a0, a1);
+            }
+
+            const array<Real, NSTATE>& b = beta[t - s];
+            Real norm = 0;
+            norm += a0 * b[0];
+            norm += a1 * b[1];
+            Real p = (norm > 0) ? (a1 * b[1]) / norm : 0;
+
+            // histereza kao u decode_hysteresis
+            if (!in_cpg && p >= POST_ENTER) {
+                in_cpg = true;
+            } else if (in_cpg && p < POST_EXIT) {
+                in_cpg = false;
+                open.close(islands, start_d);
+            }
+
+            if (in_cpg && t >= keep_lo && t <= keep_hi && !(p < POST_TRIM)) {
+                if (open.first < 0) open.first = t;
+                open.last = t;
+            }
+        }
+    }
+    if (in_cpg) open.close(islands, start_d);
+
+    return islands;
+}
+
+template vector<CpgRegion> decode_islands_fused<float>(ObsView, const HMM&, int, int, int,
+                                                      double, double, double, size_t);
+template vector<CpgRegion> decode_islands_fused<double>(ObsView, const HMM&, int, int, int,
+                                                       double, double, double, size_t);
+
+
+vector<CpgRegion> decode_islands_viterbi(
+    ObsView Oseg,
+    const HMM& hmm,
+    int start_d,
+    int keep_left_d,
+    int keep_right_d
+) {
+    vector<CpgRegion> islands;
+    int L = (int)Oseg.size();
+    if (L == 0) return islands;
+
+    const TransferTable tt = make_transfer_table(hmm);
+    double logM[NSYM][NSTATE][NSTATE];
+    for (int k = 0; k < NSYM; k++) {
+        for (int i = 0; i < NSTATE; i++) {
+            for (int j = 0; j < NSTATE; j++) logM[k][i][j] = log(tt.M[k][i][j]);
+        }
+    }
+
+    // traceback: bit 2t + j je prethodno stanje najboljeg puta koji u t završava u stanju j
+    vector<uint64_t> traceback(((size_t)L * NSTATE + 63) / 64, 0);
+
+    double v0 = log(tt.start[Oseg[0]][0]);
+    double v1 = log(tt.start[Oseg[0]][1]);
+    uint64_t word = 0;
+
+    for (int t = 1; t < L; t++) {
+        const double (*m)[NSTATE] = logM[Oseg[t]];
+        double x00 = v0 + m[0][0], x10 = v1 + m[1][0];
+        double x01 = v0 + m[0][1], x11 = v1 + m[1][1];
+        bool from1_to0 = x10 > x00;
+        bool from1_to1 = x11 > x01;
+        v0 = from1_to0 ? x10 : x00;
+        v1 = from1_to1 ? x11 : x01;
+
+        word |= (uint64_t)(from1_to0 | (from1_to1 << 1)) << (2 * (t & 31));
+        if ((t & 31) == 31) {
+            traceback[t >> 5] = word;
+            word = 0;
+
+            double mx = max(v0, v1);
+            if (isfinite(mx)) {
+                v0 -= mx;
+                v1 -= mx;
+            }
+        }
+    }
+    if (((L - 1) & 31) != 31) traceback[(L - 1) >> 5] = word;
+
+    // traceback od kraja; otoci (nizovi stanja 1) nastaju obrnutim redom
+    int state = (v1 > v0) ? 1 : 0;
+    int run_end = (state == 1) ? L - 1 : -1;
+    for (int t = L - 1; t > 0; t--) {
+        int prev = (int)((traceback[t >> 5] >> (2 * (t & 31) + state)) & 1);
+        if (state == 1 && prev == 0) {
+            islands.push_back({t + 1 + start_d, run_end + 2 + start_d, 0});
+        } else if (state == 0 && prev == 1) {
+            run_end = t - 1;
+        }
+        state = prev;
+    }
+    if (state == 1) islands.push_back({1 + start_d, run_end + 2 + start_d, 0});
+
+    reverse(islands.begin(), islands.end());
+    keep_and_clip(islands, keep_left_d + 1, keep_right_d + 1); // +1 zbog 1-based koordinata
+
+    return islands;
+}
+
+
+vector<CpgRegion> process_window(
+    ObsView O,
+    const PackedSequence& sequence,
+    const HMM& hmm,
+    int start_d,
+    int end_d,
+    int T,
+    double POST_ENTER, 
+    double POST_EXIT, 
+    double POST_TRIM, 
+    int OVERLAP,
+    size_t memory_budget,
+    ThreadPool* scan_pool,
+    bool viterbi,
+    ostream& out
+) {
+    ObsView Oseg = O.sub(start_d, end_d - start_d);
+
+    int keep_left_d  = (start_d == 0) ? start_d : start_d + OVERLAP / 2;
+    int keep_right_d = (end_d == T)   ? end_d  : end_d  - OVERLAP / 2;
+
+    vector<CpgRegion> islands;
+    if (viterbi) {
+        islands = decode_islands_viterbi(Oseg, hmm, start_d, keep_left_d, keep_right_d);
+        filter_lenght_and_merge_close_islands(islands);
+        filter_by_content(sequence, islands);
+    } else if (scan_pool) {
+        vector<lattice_t> posterior;
+        posterior_parallel(Oseg, hmm, *scan_pool, posterior);
+        islands = islands_from_posterior(
+            posterior, sequence, start_d, end_d, T,
+            POST_ENTER, POST_EXIT, POST_TRIM, OVERLAP
+        );
+    } else {
+        islands = decode_islands_fused(
+            Oseg, hmm, start_d, keep_left_d, keep_right_d,
+            POST_ENTER, POST_EXIT, POST_TRIM, memory_budget
+        );
+        filter_lenght_and_merge_close_islands(islands);
+        filter_by_content(sequence, islands);
+    }
+
+    out << "Window " << start_d << "-" << end_d
+        << " (bp keep " << keep_left_d + 1 << "-" << keep_right_d + 1
+        << "), islands=" << islands.size() << "\n";
 
     return islands;
 }
@@ -1,8 +1,12 @@
 #pragma once
 
 #include <string>
+#include <iostream>
+
+#include "../genome/genome_store.hpp"
 
 #include "./forward_backward.hpp"
+#include "./parallel_scan.hpp"
 
 using namespace std;
 
@@ -17,8 +21,10 @@ using namespace std;
  * @return vector<double> Vektor posteriornih vjerojatnosti za svaki dinukleotid u segmentu
  * 
  * Napomena: Funkcija koristi skalirane verzije forward i backward algoritama kako bi se izbjegle numeričke nestabilnosti.
+ * Real je preciznost latticea i posteriora (zadano lattice_t).
  */
-vector<double> compute_posterior_c(const vector<int>& Oseg, const HMM& hmm);
+template <class Real = lattice_t>
+vector<Real> compute_posterior_c(ObsView Oseg, const HMM& hmm);
 
 
 /**
@@ -32,19 +38,109 @@ vector<double> compute_posterior_c(const vector<int>& Oseg, const HMM& hmm);
  * 
  * @return vector<int> Vektor tvrdih stanja (0 = non-CpG, 1 = CpG) za svaki dinukleotid
  */
-vector<int> decode_hysteresis(const vector<double>& posterior_c, double enter_th, double exit_th);
+template <class Real>
+vector<int> decode_hysteresis(const vector<Real>& posterior_c, double enter_th, double exit_th);
+
+
+/**
+ * @brief Od posteriora jednog prozora do CpG otoka: dekodiranje s histerezom,
+ * ekstrakcija otoka, mapiranje u globalne koordinate, uklanjanje rubnih
+ * artefakata, trim po posterioru i filtriranje po sadržaju.
+ *
+ * Parametri su isti kao za process_window; posterior je rezultat
+ * compute_posterior_c za segment [start_d, end_d).
+ *
+ * @return vector<CpgRegion> Lista CpG otoka u globalnim baznim koordinatama
+ */
+template <class Real>
+vector<CpgRegion> islands_from_posterior(
+    const vector<Real>& posterior,
+    const PackedSequence& sequence,
+    int start_d,
+    int end_d,
+    int T,
+    double POST_ENTER, 
+    double POST_EXIT, 
+    double POST_TRIM, 
+    int OVERLAP
+);
+
+
+/**
+ * @brief Spojeno dekodiranje prozora: posterior, histereza, ekstrakcija otoka,
+ * keep_and_clip i trim po posterioru u jednom backward i jednom forward prolazu.
+ *
+ * Backward prolaz (beta normalizirana po koraku) ide prvi, pa forward prolaz
+ * računa posterior redom po t i odmah provodi histerezu. Za svaki otvoreni otok
+ * pamte se samo prvi i zadnji indeks s posteriorom >= POST_TRIM unutar intervala
+ * zadržavanja, pa se posterior i stanja ne pohranjuju. Pohranjuje se samo beta;
+ * uz memory_budget > 0 i ona samo u checkpointima (beta segmenta se ponovno računa).
+ *
+ * Rezultat odgovara islands_from_posterior prije filtriranja po duljini i sadržaju.
+ *
+ * @param Oseg Opažanja prozora
+ * @param hmm Trenirani HMM model
+ * @param start_d Početni indeks dinukleotida prozora (0-based)
+ * @param keep_left_d Početak intervala zadržavanja (dinukleotidi, 0-based)
+ * @param keep_right_d Kraj intervala zadržavanja (dinukleotidi, exclusive)
+ * @param POST_ENTER Prag ulaska u CpG stanje (histerezis)
+ * @param POST_EXIT Prag izlaska iz CpG stanja (histerezis)
+ * @param POST_TRIM Prag posteriora za trimanje rubova CpG otoka
+ * @param memory_budget Budžet radne memorije u bajtovima (0 = cijela beta)
+ *
+ * @return vector<CpgRegion> CpG otoci u globalnim baznim koordinatama
+ */
+template <class Real = lattice_t>
+vector<CpgRegion> decode_islands_fused(
+    ObsView Oseg,
+    const HMM& hmm,
+    int start_d,
+    int keep_left_d,
+    int keep_right_d,
+    double POST_ENTER,
+    double POST_EXIT,
+    double POST_TRIM,
+    size_t memory_budget = 0
+);
+
+
+/**
+ * @brief Viterbi dekodiranje prozora: CpG otoci iz najvjerojatnijeg puta stanja.
+ *
+ * Rekurzija se računa u log-prostoru (double, zbrajanje i max umjesto množenja),
+ * a vrijednosti se svakih 32 koraka pomiču za maksimum. Traceback se pohranjuje
+ * kao 1 bit po stanju po poziciji (2 bita po dinukleotidu, oko 37 MB za
+ * 150 Mbp), a otoci se ekstrahiraju tijekom tracebacka, pa se put ne pohranjuje.
+ * Kod jednakih vrijednosti prednost ima stanje B.
+ *
+ * Rezultat odgovara extract_cpg_islands nad Viterbi putem, uz pomak i
+ * keep_and_clip; trim po posterioru se ne provodi jer posterior ne postoji.
+ *
+ * @param Oseg Opažanja prozora
+ * @param hmm Trenirani HMM model
+ * @param start_d Početni indeks dinukleotida prozora (0-based)
+ * @param keep_left_d Početak intervala zadržavanja (dinukleotidi, 0-based)
+ * @param keep_right_d Kraj intervala zadržavanja (dinukleotidi, exclusive)
+ *
+ * @return vector<CpgRegion> CpG otoci u globalnim baznim koordinatama
+ */
+vector<CpgRegion> decode_islands_viterbi(
+    ObsView Oseg,
+    const HMM& hmm,
+    int start_d,
+    int keep_left_d,
+    int keep_right_d
+);
 
 
 /**
  * @brief Obrada jednog preklapajućeg prozora dinukleotida radi predikcije CpG otoka.
  *
  * Funkcija:
- *  - izdvaja segment opažanja
- *  - računa posteriorne vjerojatnosti (forward/backward)
- *  - dekodira tvrda stanja s histerezom
- *  - ekstrahira CpG otoke
- *  - mapira ih u globalne bazne koordinate
- *  - uklanja rubne artefakte, trimma po posterioru i filtrira po sadržaju
+ *  - izdvaja segment opažanja (pogled, bez kopiranja)
+ *  - spojenim dekodiranjem (decode_islands_fused) dobiva otoke u globalnim
+ *    baznim koordinatama, bez rubnih artefakata i trimane po posterioru
+ *  - filtrira otoke po duljini i sadržaju
  *
  * @param O Globalni vektor dinukleotidnih opažanja
  * @param sequence Globalna bazna sekvenca kromosoma
@@ -56,12 +152,20 @@ vector<int> decode_hysteresis(const vector<double>& posterior_c, double enter_th
  * @param POST_EXIT Prag izlaska iz CpG stanja (histerezis)
  * @param POST_TRIM Prag posteriora za trimanje rubova CpG otoka
  * @param OVERLAP Broj dinukleotida preklapanja između susjednih prozora
+ * @param memory_budget Ako je > 0, beta se pohranjuje samo u checkpointima
+ *        uz taj budžet radne memorije (bajtovi)
+ * @param scan_pool Ako nije nullptr, posterior se računa paralelnim scanom po
+ *        vremenu (posterior_parallel), a otoci iz njega (islands_from_posterior)
+ * @param viterbi Ako je true, otoci se dobivaju Viterbi putem (decode_islands_viterbi)
+ *        umjesto posteriora i histereze; memory_budget i scan_pool se ne koriste
+ * @param out Tok za ispis linije o prozoru (kod paralelne obrade prozora svaki
+ *        prozor piše u svoj međuspremnik, a ispis ide redom po prozorima)
  *
  * @return vector<CpgRegion> Lista predviđenih CpG otoka u globalnim baznim koordinatama
  */
 vector<CpgRegion> process_window(
-    const vector<int>& O,
-    const string& sequence,
+    ObsView O,
+    const PackedSequence& sequence,
     const HMM& hmm,
     int start_d,
     int end_d,
@@ -69,5 +173,9 @@ vector<CpgRegion> process_window(
     double POST_ENTER, 
     double POST_EXIT, 
     double POST_TRIM, 
-    int OVERLAP
+    int OVERLAP,
+    size_t memory_budget = 0,
+    ThreadPool* scan_pool = nullptr,
+    bool viterbi = false,
+    ostream& out = cout
 );
@@ -1,174 +1,156 @@
-#include "./forward_backward.hpp"    
+#include "./forward_backward.hpp"
+#include "./two_state_kernel.hpp"
 
-double forward_scaled(
-    const vector<int>& O,
-    const HMM& hmm,
-    vector<array<double, NSTATE>>& alpha,
-    vector<double>& c
+#include <iostream>
+
+
+TransferTable make_transfer_table(const HMM& hmm) {
+    TransferTable tt;
+    for (int k = 0; k < NSYM; k++) {
+        for (int i = 0; i < NSTATE; i++) {
+            tt.start[k][i] = hmm.pi[i] * hmm.B[i][k];
+            for (int j = 0; j < NSTATE; j++)
+                tt.M[k][i][j] = hmm.A[i][j] * hmm.B[j][k];
+        }
+    }
+    return tt;
+}
+
+
+namespace {
+
+template <class Mask, class Real>
+double forward_two_state(
+    ObsView O,
+    const RealTable<Real>& tt,
+    const Mask& mask,
+    vector<array<Real, NSTATE>>& alpha,
+    vector<Real>& c
 ) {
     int T = (int)O.size();
-    alpha.assign(T, {});
-    c.assign(T, 0.0);
-
-    // t = 0
-    c[0] = 0.0;
-    for (int i = 0; i < NSTATE; i++) {
-        alpha[0][i] = hmm.pi[i] * hmm.B[i][O[0]];
-        c[0] += alpha[0][i];
-    }
+    alpha.resize(T);
+    c.resize(T);
+    if (T == 0) return 0.0;
 
-    // AKO je suma 0 ili nije finite -> postavi uniformno i nastavi (sprječava 0*inf => NaN)
-    if (!isfinite(c[0]) || c[0] <= 0.0) {
-        for (int i = 0; i < NSTATE; i++) alpha[0][i] = 1.0 / NSTATE;
-        c[0] = 1.0;
-    } else {
-        c[0] = 1.0 / c[0];
-        if (!isfinite(c[0]) || c[0] > 1e300) c[0] = 1e300;
-        for (int i = 0; i < NSTATE; i++) alpha[0][i] *= c[0];
-    }
+    LogScaleAccumulator acc;
 
-    // t = 1..T-1
-    for (int t = 1; t < T; t++) {
-        c[t] = 0.0;
-        for (int j = 0; j < NSTATE; j++) {
-            double sum = 0.0;
-            for (int i = 0; i < NSTATE; i++)
-                sum += alpha[t-1][i] * hmm.A[i][j];
-
-            alpha[t][j] = sum * hmm.B[j][O[t]];
-            c[t] += alpha[t][j];
-        }
+    Real a0, a1;
+    c[0] = forward_start(O, tt, mask, a0, a1);
+    alpha[0] = {a0, a1};
+    acc.add(c[0]);
 
-        // fallback ako suma pukne
-        if (!isfinite(c[t]) || c[t] <= 0.0) {
-            for (int j = 0; j < NSTATE; j++) alpha[t][j] = 1.0 / NSTATE;
-            c[t] = 1.0;
-        } else {
-            c[t] = 1.0 / c[t];
-            if (!isfinite(c[t]) || c[t] > 1e300) c[t] = 1e300;
-            for (int j = 0; j < NSTATE; j++) alpha[t][j] *= c[t];
-        }
+    for (int t = 1; t < T; t++) {
+        c[t] = forward_step(O, tt, mask, t, a0, a1);
+        alpha[t] = {a0, a1};
+        acc.add(c[t]);
     }
 
-    double loglik = 0.0;
-    for (int t = 0; t < T; t++) {
-        // log(c[t]) je OK jer smo osigurali c[t] > 0 i finite
-        loglik -= log(c[t]);
-    }
-    return loglik;
+    return -acc.log();
 }
 
-double forward_scaled_masked(
-    const vector<int>& O,
-    const HMM& hmm,
-    const vector<array<double, NSTATE>>& state_mask,
-    vector<array<double, NSTATE>>& alpha,
-    vector<double>& c
+
+template <class Mask, class Real>
+void backward_two_state(
+    ObsView O,
+    const RealTable<Real>& tt,
+    const Mask& mask,
+    const vector<Real>& c,
+    vector<array<Real, NSTATE>>& beta
 ) {
     int T = (int)O.size();
-    alpha.assign(T, {});
-    c.assign(T, 0.0);
-
-    // t = 0
-    c[0] = 0.0;
-    for (int i = 0; i < NSTATE; i++) {
-        alpha[0][i] = hmm.pi[i] * hmm.B[i][O[0]] * state_mask[0][i];
-        c[0] += alpha[0][i];
-    }
+    beta.resize(T);
+    if (T == 0) return;
 
-    if (!isfinite(c[0]) || c[0] <= 0.0) {
-        double mask_sum = 0.0;
-        for (int i = 0; i < NSTATE; i++) mask_sum += state_mask[0][i];
-        if (mask_sum <= 0.0) {
-            for (int i = 0; i < NSTATE; i++) alpha[0][i] = 1.0 / NSTATE;
-        } else {
-            for (int i = 0; i < NSTATE; i++) alpha[0][i] = state_mask[0][i] / mask_sum;
-        }
-        c[0] = 1.0;
-    } else {
-        c[0] = 1.0 / c[0];
-        if (!isfinite(c[0]) || c[0] > 1e300) c[0] = 1e300;
-        for (int i = 0; i < NSTATE; i++) alpha[0][i] *= c[0];
-    }
-
-    // t = 1..T-1
-    for (int t = 1; t < T; t++) {
-        c[t] = 0.0;
-        for (int j = 0; j < NSTATE; j++) {
-            double sum = 0.0;
-            for (int i = 0; i < NSTATE; i++)
-                sum += alpha[t-1][i] * hmm.A[i][j];
-
-            alpha[t][j] = sum * hmm.B[j][O[t]] * state_mask[t][j];
-            c[t] += alpha[t][j];
-        }
+    Real b0 = c[T-1] * (Real)mask.at(T-1, 0);
+    Real b1 = c[T-1] * (Real)mask.at(T-1, 1);
+    beta[T-1] = {b0, b1};
 
-        if (!isfinite(c[t]) || c[t] <= 0.0) {
-            double mask_sum = 0.0;
-            for (int j = 0; j < NSTATE; j++) mask_sum += state_mask[t][j];
-            if (mask_sum <= 0.0) {
-                for (int j = 0; j < NSTATE; j++) alpha[t][j] = 1.0 / NSTATE;
-            } else {
-                for (int j = 0; j < NSTATE; j++) alpha[t][j] = state_mask[t][j] / mask_sum;
-            }
-            c[t] = 1.0;
-        } else {
-            c[t] = 1.0 / c[t];
-            if (!isfinite(c[t]) || c[t] > 1e300) c[t] = 1e300;
-            for (int j = 0; j < NSTATE; j++) alpha[t][j] *= c[t];
-        }
+    for (int t = T-2; t >= 0; t--) {
+        backward_step(O, tt, mask, t, c[t], b0, b1);
+        beta[t] = {b0, b1};
     }
+}
 
-    double loglik = 0.0;
-    for (int t = 0; t < T; t++) {
-        loglik -= log(c[t]);
+} // namespace
+
+
+/**
+ * Razmak checkpointa K: radna memorija je oko (T / K + K) * bytes_per_step bajtova,
+ * što je najmanje za K = sqrt(T). Uz zadani budžet uzima se najveći K koji stane
+ * (manje segmenata, isti broj koraka); ako budžet nije dovoljan ni za sqrt(T),
+ * koristi se sqrt(T).
+ */
+int checkpoint_interval(int T, size_t bytes_per_step, size_t memory_budget) {
+    int k_min = max(1, (int)ceil(sqrt((double)T)));
+    if (memory_budget == 0) return k_min;
+
+    double steps = (double)memory_budget / (double)bytes_per_step;
+    // K + T / K <= steps  =>  K <= (steps + sqrt(steps^2 - 4T)) / 2
+    double disc = steps * steps - 4.0 * (double)T;
+    if (disc < 0.0) {
+        cerr << "Memorijski budžet " << memory_budget << " B je premalen za checkpointe, koristi se K = "
+             << k_min << "\n";
+        return k_min;
     }
-    return loglik;
+    double k_max = (steps + sqrt(disc)) / 2.0;
+    return (int)max((double)k_min, min((double)T, floor(k_max)));
 }
 
 
-void backward_scaled(
-    const vector<int>& O,
+template <class Real>
+double forward_scaled(
+    ObsView O,
     const HMM& hmm,
-    const vector<double>& c,
-    vector<array<double, NSTATE>>& beta
+    vector<array<Real, NSTATE>>& alpha,
+    vector<Real>& c
 ) {
-    int T = O.size();
-    beta.assign(T, {});
+    return forward_two_state(O, RealTable<Real>(make_transfer_table(hmm)), NoMask{}, alpha, c);
+}
 
-    for (int i = 0; i < NSTATE; i++)
-        beta[T-1][i] = c[T-1];
 
-    for (int t = T-2; t >= 0; t--) {
-        for (int i = 0; i < NSTATE; i++) {
-            beta[t][i] = 0.0;
-            for (int j = 0; j < NSTATE; j++)
-                beta[t][i] += hmm.A[i][j] * hmm.B[j][O[t+1]] * beta[t+1][j];
-            beta[t][i] *= c[t];
-        }
-    }
+template <class Real>
+double forward_scaled_masked(
+    ObsView O,
+    const HMM& hmm,
+    MaskView state_mask,
+    vector<array<Real, NSTATE>>& alpha,
+    vector<Real>& c
+) {
+    return forward_two_state(O, RealTable<Real>(make_transfer_table(hmm)), StateMask{state_mask}, alpha, c);
 }
 
 
-void backward_scaled_masked(
-    const vector<int>& O,
+template <class Real>
+void backward_scaled(
+    ObsView O,
     const HMM& hmm,
-    const vector<array<double, NSTATE>>& state_mask,
-    const vector<double>& c,
-    vector<array<double, NSTATE>>& beta
+    const vector<Real>& c,
+    vector<array<Real, NSTATE>>& beta
 ) {
-    int T = O.size();
-    beta.assign(T, {});
+    backward_two_state(O, RealTable<Real>(make_transfer_table(hmm)), NoMask{}, c, beta);
+}
 
-    for (int i = 0; i < NSTATE; i++)
-        beta[T-1][i] = c[T-1] * state_mask[T-1][i];
 
-    for (int t = T-2; t >= 0; t--) {
-        for (int i = 0; i < NSTATE; i++) {
-            beta[t][i] = 0.0;
-            for (int j = 0; j < NSTATE; j++)
-                beta[t][i] += hmm.A[i][j] * hmm.B[j][O[t+1]] * state_mask[t+1][j] * beta[t+1][j];
-            beta[t][i] *= c[t];
-        }
-    }
+template <class Real>
+void backward_scaled_masked(
+    ObsView O,
+    const HMM& hmm,
+    MaskView state_mask,
+    const vector<Real>& c,
+    vector<array<Real, NSTATE>>& beta
+) {
+    backward_two_state(O, RealTable<Real>(make_transfer_table(hmm)), StateMask{state_mask}, c, beta);
 }
+
+
+// obje preciznosti se prevode neovisno o PRECISION, radi usporedbe (precision_report)
+#define INSTANTIATE_FORWARD_BACKWARD(Real) \
+    template double forward_scaled<Real>(ObsView, const HMM&, vector<array<Real, NSTATE>>&, vector<Real>&); \
+    template double forward_scaled_masked<Real>(ObsView, const HMM&, MaskView, \
+                                                vector<array<Real, NSTATE>>&, vector<Real>&); \
+    template void backward_scaled<Real>(ObsView, const HMM&, const vector<Real>&, vector<array<Real, NSTATE>>&); \
+    template void backward_scaled_masked<Real>(ObsView, const HMM&, MaskView, \
+                                               const vector<Real>&, vector<array<Real, NSTATE>>&);
+
+INSTANTIATE_FORWARD_BACKWARD(float)
+INSTANTIATE_FORWARD_BACKWARD(double)
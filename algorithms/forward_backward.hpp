@@ -3,15 +3,81 @@
 #include <vector>
 #include <array>
 #include <cmath>
+#include <cstring>
+#include <cstdint>
 
 #include "../utils/structs_consts_functions.hpp"
 
 using namespace std;
 
 
+/**
+ * Preciznost latticea (alpha, beta, c i posterior). Zadano je double;
+ * `make PRECISION=float` prevodi s CPG_SINGLE_PRECISION, pa se lattice pohranjuje
+ * i računa u float (upola manje memorije po prozoru). Log-vjerojatnost i
+ * očekivani brojevi Baum-Welcha se u oba načina zbrajaju u double.
+ */
+#ifdef CPG_SINGLE_PRECISION
+typedef float lattice_t;
+#else
+typedef double lattice_t;
+#endif
+
+
+/**
+ * Gornja granica skalirajućeg faktora c: 1e300 za double, a za float mora
+ * ostati daleko ispod FLT_MAX jer se beta množi s c.
+ */
+template <class Real> constexpr Real scale_limit();
+template <> constexpr double scale_limit<double>() { return 1e300; }
+template <> constexpr float scale_limit<float>() { return 1e30f; }
+
+
+/**
+ * Prijelazni produkti modela s dva stanja: M[k][i][j] = A[i][j] * B[j][k]
+ * za svaki simbol k, te početni produkti pi[i] * B[i][k].
+ *
+ * Računaju se jednom po modelu, pa jedan korak forward/backward rekurzije
+ * za opažanje k postaje množenje 2x2 matricom M[k] (bez ponovnog množenja A i B).
+ */
+static_assert(NSTATE == 2, "forward/backward kernel je specijaliziran za model s dva stanja");
+
+struct TransferTable {
+    double M[NSYM][NSTATE][NSTATE];
+    double start[NSYM][NSTATE];
+};
+
+TransferTable make_transfer_table(const HMM& hmm);
+
+
+/**
+ * Log-vjerojatnost kao -sum log(c[t]) bez logaritma po koraku: produkt
+ * skalirajućih faktora drži se kao mantisa u [1, 2) i zbroj eksponenata.
+ * c[t] je uvijek u [0.5, 1e300], pa produkt nikad ne izlazi iz normalnih brojeva.
+ */
+struct LogScaleAccumulator {
+    double mantissa = 1.0;
+    long long exponent = 0;
+
+    void add(double c) {
+        double p = mantissa * c;
+        uint64_t bits;
+        memcpy(&bits, &p, sizeof(bits));
+        exponent += (long long)((bits >> 52) & 0x7ff) - 1023;
+        bits = (bits & ~(0x7ffULL << 52)) | (1023ULL << 52);
+        memcpy(&mantissa, &bits, sizeof(bits));
+    }
+
+    double log() const { return (double)exponent * M_LN2 + std::log(mantissa); }
+};
+
+
 /**
  * @brief Forward algoritam sa skaliranjem kako bi izbjegli padanje
  * vrijednosti alpha u 0.
+ *
+ * Real je preciznost latticea (float ili double); rekurzija se računa u Real,
+ * a log-vjerojatnost se zbraja u double.
  * 
  * @param O Sekvenca opažanja
  * @param hmm HMM parametri
@@ -20,11 +86,12 @@ using namespace std;
  * 
  * @return double Log-vjerojatnost sekvence
  */
+template <class Real>
 double forward_scaled(
-    const vector<int>& O,
+    ObsView O,
     const HMM& hmm,
-    vector<array<double, NSTATE>>& alpha,
-    vector<double>& c
+    vector<array<Real, NSTATE>>& alpha,
+    vector<Real>& c
 );
 
 
@@ -33,18 +100,19 @@ double forward_scaled(
  *
  * @param O Sekvenca opažanja
  * @param hmm HMM parametri
- * @param state_mask Maska dozvoljenih stanja (0/1) za svaki t
+ * @param state_mask Maska dozvoljenih stanja (bit po stanju) za svaki t
  * @param alpha Matrica za pohranu forward varijabli
  * @param c Vektor skalirajućih faktora
  *
  * @return double Log-vjerojatnost sekvence
  */
+template <class Real>
 double forward_scaled_masked(
-    const vector<int>& O,
+    ObsView O,
     const HMM& hmm,
-    const vector<array<double, NSTATE>>& state_mask,
-    vector<array<double, NSTATE>>& alpha,
-    vector<double>& c
+    MaskView state_mask,
+    vector<array<Real, NSTATE>>& alpha,
+    vector<Real>& c
 );
 
 
@@ -57,11 +125,12 @@ double forward_scaled_masked(
  * @param c Vektor skalirajućih faktora iz forward algoritma
  * @param beta Matrica za pohranu backward varijabli
  */
+template <class Real>
 void backward_scaled(
-    const vector<int>& O,
+    ObsView O,
     const HMM& hmm,
-    const vector<double>& c,
-    vector<array<double, NSTATE>>& beta
+    const vector<Real>& c,
+    vector<array<Real, NSTATE>>& beta
 );
 
 /**
@@ -69,14 +138,15 @@ void backward_scaled(
  *
  * @param O Niz opažanja
  * @param hmm HMM parametri
- * @param state_mask Maska dozvoljenih stanja (0/1) za svaki t
+ * @param state_mask Maska dozvoljenih stanja (bit po stanju) za svaki t
  * @param c Vektor skalirajućih faktora iz forward algoritma
  * @param beta Matrica za pohranu backward varijabli
  */
+template <class Real>
 void backward_scaled_masked(
-    const vector<int>& O,
+    ObsView O,
     const HMM& hmm,
-    const vector<array<double, NSTATE>>& state_mask,
-    const vector<double>& c,
-    vector<array<double, NSTATE>>& beta
+    MaskView state_mask,
+    const vector<Real>& c,
+    vector<array<Real, NSTATE>>& beta
 );
@@ -0,0 +1,133 @@
+#include "./forward_only_counts.hpp"
+
+#include <cfloat>
+
+
+namespace {
+
+// statistike po završnom stanju: A_num[i][j] pa B_num[i][k]
+constexpr int STAT_A = 0;
+constexpr int STAT_B = NSTATE * NSTATE;
+constexpr int NSTAT = NSTATE * NSTATE + NSTATE * NSYM;
+
+
+// out = w0 * F0 + w1 * F1 po svim statistikama
+inline void mix_stats(const double* __restrict F0, const double* __restrict F1,
+                      double w0, double w1, double* __restrict out) {
+    for (int x = 0; x < NSTAT; x++) out[x] = w0 * F0[x] + w1 * F1[x];
+}
+
+
+/**
+ * Forward-only E-korak jedne sekvence; vraća log-vjerojatnost (brojevi se
+ * upisuju u counts samo ako je konačna).
+ */
+double forward_only_sequence(ObsView O, MaskView mask, const TransferTable& tt, ExpectedCounts& counts) {
+    const int T = (int)O.size();
+
+    // F i next se izmjenjuju po koraku (bez kopiranja)
+    double buf[2][NSTATE][NSTAT] = {{{0}}};
+    double (*F)[NSTAT] = buf[0];
+    double (*next)[NSTAT] = buf[1];
+    double a[NSTATE];
+    LogScaleAccumulator acc;
+
+    for (int t = 0; t < T; t++) {
+        const int sym = O[t];
+        double m[NSTATE];
+        for (int l = 0; l < NSTATE; l++) m[l] = mask_allows(mask[t], l);
+
+        // p[i][l] = P(Z_{t-1} = i, Z_t = l, o_t | O_1..t-1); za t = 0 početni produkti u p[0]
+        double p[NSTATE][NSTATE];
+        double s = 0.0;
+        for (int i = 0; i < NSTATE; i++) {
+            for (int l = 0; l < NSTATE; l++) {
+                p[i][l] = (t == 0) ? ((i == 0) ? tt.start[sym][l] * m[l] : 0.0)
+                                   : a[i] * tt.M[sym][i][l] * m[l];
+                s += p[i][l];
+            }
+        }
+
+        if (s > 0.0 && s <= DBL_MAX) {
+            const double ct = 1.0 / s;
+            acc.add(ct);
+            for (int l = 0; l < NSTATE; l++) a[l] = (p[0][l] + p[1][l]) * ct;
+
+            // za t = 0 F je nula, pa doprinosi samo emisija
+            if (t > 0) {
+                for (int l = 0; l < NSTATE; l++) {
+                    const double w0 = tt.M[sym][0][l] * m[l] * ct;
+                    const double w1 = tt.M[sym][1][l] * m[l] * ct;
+                    mix_stats(F[0], F[1], w0, w1, next[l]);
+                    for (int i = 0; i < NSTATE; i++) next[l][STAT_A + i * NSTATE + l] += p[i][l] * ct;
+                }
+                swap(F, next);
+            }
+
+        } else {
+            // suma pukne: alpha je maska normalizirana na 1 (kao u forward kernelu),
+            // a dosadašnji brojevi se dijele po novom alpha
+            double ms = m[0] + m[1];
+            for (int l = 0; l < NSTATE; l++) a[l] = (ms > 0.0) ? m[l] / ms : 1.0 / NSTATE;
+            for (int l = 0; l < NSTATE; l++) mix_stats(F[0], F[1], a[l], a[l], next[l]);
+            swap(F, next);
+        }
+
+        for (int l = 0; l < NSTATE; l++) F[l][STAT_B + l * NSYM + sym] += a[l];
+    }
+
+    double seq_ll = -acc.log();
+    if (!isfinite(seq_ll)) return seq_ll;
+
+    for (int i = 0; i < NSTATE; i++) {
+        for (int j = 0; j < NSTATE; j++) {
+            double x = F[0][STAT_A + i * NSTATE + j] + F[1][STAT_A + i * NSTATE + j];
+            counts.A_num[i][j] = x;
+            counts.A_den[i] += x;
+        }
+        for (int k = 0; k < NSYM; k++) {
+            double x = F[0][STAT_B + i * NSYM + k] + F[1][STAT_B + i * NSYM + k];
+            counts.B_num[i][k] = x;
+            counts.B_den[i] += x;
+        }
+    }
+    counts.used_sequences = 1;
+    return seq_ll;
+}
+
+} // namespace
+
+
+void expected_counts_forward_only(
+    const vector<ObsView>& sequences,
+    const vector<MaskView>& state_masks,
+    const HMM& hmm,
+    ExpectedCounts& counts,
+    double& ll,
+    ThreadPool* pool
+) {
+    if (sequences.empty()) return;
+
+    const TransferTable tt = make_transfer_table(hmm);
+    vector<ExpectedCounts> seq_counts(sequences.size());
+    vector<double> seq_ll(sequences.size(), 0.0);
+
+    auto run_sequence = [&](size_t k) {
+        if (sequences[k].size() < 2) return;
+
+        ExpectedCounts c;
+        double l = forward_only_sequence(sequences[k], state_masks[k], tt, c);
+        if (!isfinite(l)) return;
+        seq_counts[k] = c;
+        seq_ll[k] = l;
+    };
+    if (pool && pool->size() > 1 && sequences.size() > 1) {
+        pool->parallel_for(sequences.size(), run_sequence);
+    } else {
+        for (size_t k = 0; k < sequences.size(); k++) run_sequence(k);
+    }
+
+    pairwise_reduce<NSTATE, NSYM>(seq_counts, seq_ll);
+    counts.add(seq_counts[0]);
+    ll += seq_ll[0];
+}
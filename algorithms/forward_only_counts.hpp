@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+
+#include "../utils/structs_consts_functions.hpp"
+#include "../utils/thread_pool.hpp"
+#include "./forward_backward.hpp"
+#include "./batched_forward_backward.hpp"
+
+using namespace std;
+
+
+/**
+ * @brief E-korak Baum-Welch algoritma samo forward prolazom (Churbanov i
+ * Winters), bez pohrane alpha i beta latticea.
+ *
+ * Uz normirani alpha_t(l) nosi se i F_t(l) = E[brojevi do t, Z_t = l | O_1..t]
+ * za sve brojeve prijelaza i emisija. Korak za opažanje o:
+ *
+ *   F_t(l) = sum_m F_{t-1}(m) * M[o][m][l] / s
+ *            + (m -> l) prijelaz s težinom alpha_{t-1}(m) * M[o][m][l] / s
+ *            + emisija (l, o) s težinom alpha_t(l),
+ *
+ * gdje je M[o][m][l] = A[m][l] * B[l][o] * maska i s skalirajući zbroj forward
+ * koraka. Očekivani brojevi sekvence su sum_l F_T(l), a A_den i B_den su
+ * zbrojevi A_num i B_num po retku. Memorija je O(1) po sekvenci (ne ovisi o
+ * duljini), a korak je oko 150 množenja, pa je put sporiji od
+ * expected_counts_batched i isplati se za duge sekvence.
+ *
+ * Sekvence kraće od 2 ili s log-vjerojatnošću koja nije konačna se preskaču.
+ * Brojevi se zbrajaju u fiksnom stablu parova po indeksu sekvence, pa je
+ * rezultat bitovno isti za bilo koji broj dretvi (i bez poola).
+ *
+ * @param sequences Vektor sekvenci opažanja (dinukleotidi)
+ * @param state_masks Vektor maski dozvoljenih stanja (bit po stanju) za svaku sekvencu
+ * @param hmm HMM parametri
+ * @param counts Očekivani brojevi (dodaju se na postojeće)
+ * @param ll Log-vjerojatnost (dodaju se log-vjerojatnosti korištenih sekvenci)
+ * @param pool Ako nije nullptr, sekvence se obrađuju paralelno
+ */
+void expected_counts_forward_only(
+    const vector<ObsView>& sequences,
+    const vector<MaskView>& state_masks,
+    const HMM& hmm,
+    ExpectedCounts& counts,
+    double& ll,
+    ThreadPool* pool = nullptr
+);
@@ -0,0 +1,443 @@
+#include "./hmm_engine.hpp"
+#include "./forward_backward.hpp"
+#include "./batched_forward_backward.hpp"
+
+#include <cfloat>
+#include <algorithm>
+
+
+namespace {
+
+template <int S, int K>
+constexpr bool is_cpg_model() {
+    return S == NSTATE && K == NSYM;
+}
+
+
+/**
+ * Matrice koraka M[k][i][j] = A[i][j] * B[j][k] i transponirane MT[k][j][i]
+ * (backward je isti umnožak vektora i matrice kao forward), te početni
+ * produkti pi[i] * B[i][k].
+ */
+template <int S, int K>
+struct StepTables {
+    vector<double> M;
+    vector<double> MT;
+    vector<double> start;
+
+    explicit StepTables(const HMMParams<S, K>& hmm) : M((size_t)K * S * S), MT((size_t)K * S * S), start((size_t)K * S) {
+        for (int k = 0; k < K; k++) {
+            for (int i = 0; i < S; i++) {
+                start[k * S + i] = hmm.pi[i] * hmm.B[i][k];
+                for (int j = 0; j < S; j++) {
+                    double m = hmm.A[i][j] * hmm.B[j][k];
+                    M[((size_t)k * S + i) * S + j] = m;
+                    MT[((size_t)k * S + j) * S + i] = m;
+                }
+            }
+        }
+    }
+
+    const double* step(int k) const { return &M[(size_t)k * S * S]; }
+    const double* step_t(int k) const { return &MT[(size_t)k * S * S]; }
+};
+
+
+/**
+ * out[j] = sum_i v[i] * M[i][j]. Za S >= 8 (djeljiv s 4) stupci se obrađuju
+ * u blokovima od 4 s dva SSE2 akumulatora (širi vektori bez -mavx se prevode
+ * lošije i mjereno su sporiji), a za male S petlje se razmotavaju.
+ */
+template <int S>
+inline void row_times_matrix(const double* v, const double* M, double* out) {
+    if constexpr (S >= 8 && S % 4 == 0) {
+        typedef double V2 __attribute__((vector_size(2 * sizeof(double)), aligned(sizeof(double))));
+        for (int jb = 0; jb < S; jb += 4) {
+            V2 acc0 = {}, acc1 = {};
+            for (int i = 0; i < S; i++) {
+                V2 m0, m1;
+                memcpy(&m0, M + i * S + jb, sizeof(m0));
+                memcpy(&m1, M + i * S + jb + 2, sizeof(m1));
+                acc0 += v[i] * m0;
+                acc1 += v[i] * m1;
+            }
+            memcpy(out + jb, &acc0, sizeof(acc0));
+            memcpy(out + jb + 2, &acc1, sizeof(acc1));
+        }
+    } else {
+        for (int j = 0; j < S; j++) {
+            double s = 0.0;
+            for (int i = 0; i < S; i++) s += v[i] * M[i * S + j];
+            out[j] = s;
+        }
+    }
+}
+
+
+/**
+ * Normalizacija kao u kernelu s dva stanja: ako suma nije pozitivna i
+ * konačna, alpha je maska normalizirana na 1 (uniformno ako je maska prazna), a c = 1.
+ */
+template <int S>
+inline double normalize_states(array<double, S>& a, const uint8_t* mask) {
+    double s = 0.0;
+    for (int j = 0; j < S; j++) s += a[j];
+
+    if (s > 0.0 && s <= DBL_MAX) {
+        double ct = min(1.0 / s, 1e300);
+        for (int j = 0; j < S; j++) a[j] *= ct;
+        return ct;
+    }
+
+    double ms = 0.0;
+    if (mask) {
+        for (int j = 0; j < S; j++) ms += mask_allows(*mask, j);
+    }
+    for (int j = 0; j < S; j++) a[j] = (ms > 0.0) ? mask_allows(*mask, j) / ms : 1.0 / S;
+    return 1.0;
+}
+
+
+template <int S, int K>
+double forward_generic(
+    ObsView O,
+    const StepTables<S, K>& tab,
+    MaskView state_mask,
+    vector<array<double, S>>& alpha,
+    vector<double>& c
+) {
+    int T = (int)O.size();
+    alpha.resize(T);
+    c.resize(T);
+    if (T == 0) return 0.0;
+
+    LogScaleAccumulator acc;
+
+    for (int t = 0; t < T; t++) {
+        array<double, S> n;
+        if (t == 0) {
+            for (int j = 0; j < S; j++) n[j] = tab.start[O[0] * S + j];
+        } else {
+            row_times_matrix<S>(alpha[t-1].data(), tab.step(O[t]), n.data());
+        }
+
+        const uint8_t* m = state_mask.empty() ? nullptr : &state_mask[t];
+        if (m) {
+            for (int j = 0; j < S; j++) n[j] *= mask_allows(*m, j);
+        }
+        c[t] = normalize_states<S>(n, m);
+        alpha[t] = n;
+        acc.add(c[t]);
+    }
+
+    return -acc.log();
+}
+
+
+template <int S, int K>
+void backward_generic(
+    ObsView O,
+    const StepTables<S, K>& tab,
+    MaskView state_mask,
+    const vector<double>& c,
+    vector<array<double, S>>& beta
+) {
+    int T = (int)O.size();
+    beta.resize(T);
+    if (T == 0) return;
+
+    for (int j = 0; j < S; j++) beta[T-1][j] = c[T-1] * (state_mask.empty() ? 1.0 : mask_allows(state_mask[T-1], j));
+
+    for (int t = T - 2; t >= 0; t--) {
+        // beta[t][i] = c[t] * sum_j M[i][j] * m[t+1][j] * beta[t+1][j]
+        array<double, S> w = beta[t+1];
+        if (!state_mask.empty()) {
+            for (int j = 0; j < S; j++) w[j] *= mask_allows(state_mask[t+1], j);
+        }
+        row_times_matrix<S>(w.data(), tab.step_t(O[t+1]), beta[t].data());
+        for (int i = 0; i < S; i++) beta[t][i] *= c[t];
+    }
+}
+
+
+inline bool valid_count(double x) {
+    return x >= 0.0 && x <= DBL_MAX;
+}
+
+
+template <int S, int K>
+void counts_generic(
+    ObsView O,
+    const HMMParams<S, K>& hmm,
+    MaskView mask,
+    const vector<array<double, S>>& alpha,
+    const vector<array<double, S>>& beta,
+    ExpectedCountsT<S, K>& counts
+) {
+    int T = (int)O.size();
+    for (int t = 0; t < T; t++) {
+        const array<double, S>& a = alpha[t];
+        const array<double, S>& b = beta[t];
+
+        double gamma_den = 0.0;
+        for (int i = 0; i < S; i++) gamma_den += a[i] * b[i];
+        if (!valid_count(gamma_den) || gamma_den == 0.0) gamma_den = 1e-300;
+
+        double gamma[S];
+        for (int i = 0; i < S; i++) {
+            gamma[i] = (a[i] * b[i]) / gamma_den;
+            double g = valid_count(gamma[i]) ? gamma[i] : 0.0;
+            counts.B_num[i][O[t]] += g;
+            counts.B_den[i] += g;
+            if (t < T - 1) counts.A_den[i] += g;
+        }
+        if (t == T - 1) break;
+
+        // xi(i, j) = alpha[t][i] * A[i][j] * B[j][O[t+1]] * m[t+1][j] * beta[t+1][j]
+        double w[S];
+        for (int j = 0; j < S; j++) w[j] = hmm.B[j][O[t+1]] * mask_allows(mask[t+1], j) * beta[t+1][j];
+
+        double xi_term[S][S];
+        double xi_den = 0.0;
+        for (int i = 0; i < S; i++) {
+            for (int j = 0; j < S; j++) {
+                xi_term[i][j] = a[i] * hmm.A[i][j] * w[j];
+                xi_den += xi_term[i][j];
+            }
+        }
+        if (!valid_count(xi_den) || xi_den == 0.0) xi_den = 1e-300;
+
+        for (int i = 0; i < S; i++) {
+            if (!valid_count(gamma[i])) continue;
+            for (int j = 0; j < S; j++) {
+                double xi = xi_term[i][j] / xi_den;
+                if (valid_count(xi)) counts.A_num[i][j] += xi;
+            }
+        }
+    }
+}
+
+} // namespace
+
+
+template <int S, int K>
+double hmm_forward(
+    ObsView O,
+    const HMMParams<S, K>& hmm,
+    MaskView state_mask,
+    vector<array<double, S>>& alpha,
+    vector<double>& c
+) {
+    if constexpr (is_cpg_model<S, K>()) {
+        return state_mask.empty() ? forward_scaled<double>(O, hmm, alpha, c)
+                                  : forward_scaled_masked<double>(O, hmm, state_mask, alpha, c);
+    } else {
+        return forward_generic<S, K>(O, StepTables<S, K>(hmm), state_mask, alpha, c);
+    }
+}
+
+
+template <int S, int K>
+void hmm_backward(
+    ObsView O,
+    const HMMParams<S, K>& hmm,
+    MaskView state_mask,
+    const vector<double>& c,
+    vector<array<double, S>>& beta
+) {
+    if constexpr (is_cpg_model<S, K>()) {
+        if (state_mask.empty()) {
+            backward_scaled<double>(O, hmm, c, beta);
+        } else {
+            backward_scaled_masked<double>(O, hmm, state_mask, c, beta);
+        }
+    } else {
+        backward_generic<S, K>(O, StepTables<S, K>(hmm), state_mask, c, beta);
+    }
+}
+
+
+template <int S, int K>
+double hmm_posterior(
+    ObsView O,
+    const HMMParams<S, K>& hmm,
+    const array<bool, S>& in_set,
+    vector<double>& posterior
+) {
+    vector<array<double, S>> alpha, beta;
+    vector<double> c;
+    double ll = hmm_forward<S, K>(O, hmm, MaskView(), alpha, c);
+    hmm_backward<S, K>(O, hmm, MaskView(), c, beta);
+
+    posterior.assign(O.size(), 0.0);
+    for (size_t t = 0; t < O.size(); t++) {
+        double norm = 0.0, in = 0.0;
+        for (int i = 0; i < S; i++) {
+            double g = alpha[t][i] * beta[t][i];
+            norm += g;
+            if (in_set[i]) in += g;
+        }
+        if (norm > 0.0) posterior[t] = in / norm;
+    }
+
+    return ll;
+}
+
+
+template <int S, int K>
+void hmm_expected_counts(
+    const vector<ObsView>& sequences,
+    const vector<MaskView>& state_masks,
+    const HMMParams<S, K>& hmm,
+    ExpectedCountsT<S, K>& counts,
+    double& ll
+) {
+    if constexpr (is_cpg_model<S, K>()) {
+        expected_counts_batched(sequences, state_masks, hmm, counts, ll);
+    } else {
+        const StepTables<S, K> tab(hmm);
+        vector<array<double, S>> alpha, beta;
+        vector<double> c;
+
+        for (size_t k = 0; k < sequences.size(); k++) {
+            ObsView O = sequences[k];
+            if (O.size() < 2) continue;
+
+            double seq_ll = forward_generic<S, K>(O, tab, state_masks[k], alpha, c);
+            if (!isfinite(seq_ll)) continue;
+            backward_generic<S, K>(O, tab, state_masks[k], c, beta);
+
+            ExpectedCountsT<S, K> seq_counts;
+            counts_generic<S, K>(O, hmm, state_masks[k], alpha, beta, seq_counts);
+            seq_counts.used_sequences = 1;
+            counts.add(seq_counts);
+            ll += seq_ll;
+        }
+    }
+}
+
+
+template <int S, int K>
+void hmm_maximization_step(ExpectedCountsT<S, K> counts, HMMParams<S, K>& hmm) {
+    const double A_PSEUDO = 1e-3;
+    const double B_PSEUDO = 1e-2;
+    const double B_FLOOR = 1e-6;
+
+    for (int i = 0; i < S; i++) {
+        if (!isfinite(counts.A_den[i]) || counts.A_den[i] <= 0.0) counts.A_den[i] = 1e-300;
+        if (!isfinite(counts.B_den[i]) || counts.B_den[i] <= 0.0) counts.B_den[i] = 1e-300;
+
+        double Aden = counts.A_den[i] + A_PSEUDO * S;
+        double Bden = counts.B_den[i] + B_PSEUDO * K;
+
+        for (int j = 0; j < S; j++) {
+            double num = counts.A_num[i][j];
+            if (!isfinite(num) || num < 0.0) num = 0.0;
+            hmm.A[i][j] = (num + A_PSEUDO) / Aden;
+        }
+
+        double bsum = 0.0;
+        for (int k = 0; k < K; k++) {
+            double num = counts.B_num[i][k];
+            if (!isfinite(num) || num < 0.0) num = 0.0;
+            hmm.B[i][k] = (num + B_PSEUDO) / Bden;
+            if (hmm.B[i][k] < B_FLOOR) hmm.B[i][k] = B_FLOOR;
+            bsum += hmm.B[i][k];
+        }
+        if (bsum > 0.0) {
+            for (int k = 0; k < K; k++) {
+                hmm.B[i][k] /= bsum;
+            }
+        }
+    }
+}
+
+
+template <int S, int K>
+double hmm_baum_welch_iteration(
+    const vector<ObsView>& sequences,
+    const vector<MaskView>& state_masks,
+    HMMParams<S, K>& hmm,
+    double& ll
+) {
+    ExpectedCountsT<S, K> counts;
+    hmm_expected_counts<S, K>(sequences, state_masks, hmm, counts, ll);
+
+    if (counts.used_sequences > 0) {
+        hmm_maximization_step<S, K>(counts, hmm);
+    }
+    return ll;
+}
+
+
+template <int S, int K>
+vector<uint8_t> hmm_viterbi(ObsView O, const HMMParams<S, K>& hmm) {
+    static_assert(S <= 256, "traceback pohranjuje stanje u jedan bajt");
+
+    int T = (int)O.size();
+    vector<uint8_t> path(T);
+    if (T == 0) return path;
+
+    const StepTables<S, K> tab(hmm);
+    vector<double> logM(tab.M.size());
+    for (size_t x = 0; x < tab.M.size(); x++) logM[x] = log(tab.M[x]);
+
+    vector<uint8_t> traceback((size_t)T * S);
+    array<double, S> v;
+    for (int j = 0; j < S; j++) v[j] = log(tab.start[O[0] * S + j]);
+
+    for (int t = 1; t < T; t++) {
+        const double* m = &logM[(size_t)O[t] * S * S];
+        uint8_t* bp = &traceback[(size_t)t * S];
+        array<double, S> n;
+        for (int j = 0; j < S; j++) {
+            double best = v[0] + m[j];
+            int arg = 0;
+            for (int i = 1; i < S; i++) {
+                double x = v[i] + m[i * S + j];
+                if (x > best) {
+                    best = x;
+                    arg = i;
+                }
+            }
+            n[j] = best;
+            bp[j] = (uint8_t)arg;
+        }
+        v = n;
+
+        // pomak za maksimum drži vrijednosti blizu 0
+        if ((t & 31) == 31) {
+            double mx = *max_element(v.begin(), v.end());
+            if (isfinite(mx)) {
+                for (int j = 0; j < S; j++) v[j] -= mx;
+            }
+        }
+    }
+
+    int state = (int)(max_element(v.begin(), v.end()) - v.begin());
+    for (int t = T - 1; t >= 0; t--) {
+        path[t] = (uint8_t)state;
+        if (t > 0) state = traceback[(size_t)t * S + state];
+    }
+
+    return path;
+}
+
+
+#define INSTANTIATE_HMM_ENGINE(S, K) \
+    template double hmm_forward<S, K>(ObsView, const HMMParams<S, K>&, MaskView, \
+                                      vector<array<double, S>>&, vector<double>&); \
+    template void hmm_backward<S, K>(ObsView, const HMMParams<S, K>&, MaskView, \
+                                     const vector<double>&, vector<array<double, S>>&); \
+    template double hmm_posterior<S, K>(ObsView, const HMMParams<S, K>&, const array<bool, S>&, vector<double>&); \
+    template void hmm_expected_counts<S, K>(const vector<ObsView>&, const vector<MaskView>&, \
+                                            const HMMParams<S, K>&, ExpectedCountsT<S, K>&, double&); \
+    template void hmm_maximization_step<S, K>(ExpectedCountsT<S, K>, HMMParams<S, K>&); \
+    template double hmm_baum_welch_iteration<S, K>(const vector<ObsView>&, const vector<MaskView>&, \
+                                                   HMMParams<S, K>&, double&); \
+    template vector<uint8_t> hmm_viterbi<S, K>(ObsView, const HMMParams<S, K>&);
+
+INSTANTIATE_HMM_ENGINE(NSTATE, NSYM)
+INSTANTIATE_HMM_ENGINE(8, 4)
+INSTANTIATE_HMM_ENGINE(2, 64)
+INSTANTIATE_HMM_ENGINE(8, 64)
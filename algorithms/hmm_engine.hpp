@@ -0,0 +1,204 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <cstdint>
+
+#include "../utils/structs_consts_functions.hpp"
+
+using namespace std;
+
+
+/**
+ * Generički HMM engine: forward, backward, posterior, E-korak, M-korak i Viterbi
+ * za model sa S stanja i K simbola (HMMParams<S, K>).
+ *
+ * Broj stanja i simbola poznat je pri prevođenju, pa se petlje po stanjima
+ * razmotavaju. Za S >= 8 (S djeljiv s 4) umnožak vektora i matrice koraka
+ * računa se u blokovima od 4 stanja (GCC vektori).
+ *
+ * Za CpG model (S = NSTATE, K = NSYM) funkcije pozivaju postojeće kernele
+ * specijalizirane za dva stanja (forward_backward.cpp i E-korak iz
+ * batched_forward_backward.cpp), pa taj put nije sporiji nego prije.
+ *
+ * Maske dozvoljenih stanja su MaskView (jedan bajt po t, bit po stanju), pa je
+ * S najviše 8.
+ *
+ * Predlošci su eksplicitno instancirani u hmm_engine.cpp za CpG model (2, 16),
+ * model s 8 stanja po nukleotidu (8, 4) te trinukleotidni kontekst (2, 64) i (8, 64).
+ */
+
+
+/**
+ * Očekivani brojevi prijelaza i emisija (E-korak Baum-Welch algoritma).
+ */
+template <int S, int K>
+struct ExpectedCountsT {
+    static_assert(S <= 8, "maska dozvoljenih stanja ima jedan bit po stanju u bajtu");
+
+    double A_num[S][S] = {{0}};
+    double A_den[S] = {0};
+    double B_num[S][K] = {{0}};
+    double B_den[S] = {0};
+    int used_sequences = 0;
+
+    void add(const ExpectedCountsT& other) {
+        for (int i = 0; i < S; i++) {
+            for (int j = 0; j < S; j++) A_num[i][j] += other.A_num[i][j];
+            for (int k = 0; k < K; k++) B_num[i][k] += other.B_num[i][k];
+            A_den[i] += other.A_den[i];
+            B_den[i] += other.B_den[i];
+        }
+        used_sequences += other.used_sequences;
+    }
+};
+
+
+/**
+ * @brief Zbraja brojeve i log-vjerojatnosti sekvenci u fiksnom stablu parova
+ * (0+1, 2+3, ..., zatim razmak 2, 4, ...); rezultat je u seq_counts[0] i
+ * seq_ll[0]. Redoslijed zbrajanja ovisi samo o broju sekvenci, pa je zbroj
+ * bitovno isti bez obzira na to koja je dretva izračunala koju sekvencu.
+ */
+template <int S, int K>
+void pairwise_reduce(vector<ExpectedCountsT<S, K>>& seq_counts, vector<double>& seq_ll) {
+    const size_t n = seq_counts.size();
+    for (size_t stride = 1; stride < n; stride *= 2) {
+        for (size_t i = 0; i + stride < n; i += 2 * stride) {
+            seq_counts[i].add(seq_counts[i + stride]);
+            seq_ll[i] += seq_ll[i + stride];
+        }
+    }
+}
+
+
+/**
+ * @brief Forward algoritam sa skaliranjem (kao forward_scaled), uz opcionalnu
+ * masku dozvoljenih stanja.
+ *
+ * @param O Sekvenca opažanja (simboli 0..K-1)
+ * @param hmm HMM parametri
+ * @param state_mask Maska dozvoljenih stanja (bit po stanju) za svaki t; prazan pogled = bez maske
+ * @param alpha Matrica za pohranu forward varijabli
+ * @param c Vektor skalirajućih faktora
+ *
+ * @return double Log-vjerojatnost sekvence
+ */
+template <int S, int K>
+double hmm_forward(
+    ObsView O,
+    const HMMParams<S, K>& hmm,
+    MaskView state_mask,
+    vector<array<double, S>>& alpha,
+    vector<double>& c
+);
+
+
+/**
+ * @brief Backward algoritam sa skaliranjem (kao backward_scaled), uz opcionalnu
+ * masku dozvoljenih stanja. Koristi skalirajuće faktore iz hmm_forward.
+ *
+ * @param O Sekvenca opažanja (simboli 0..K-1)
+ * @param hmm HMM parametri
+ * @param state_mask Maska dozvoljenih stanja (bit po stanju) za svaki t; prazan pogled = bez maske
+ * @param c Vektor skalirajućih faktora iz forward algoritma
+ * @param beta Matrica za pohranu backward varijabli
+ */
+template <int S, int K>
+void hmm_backward(
+    ObsView O,
+    const HMMParams<S, K>& hmm,
+    MaskView state_mask,
+    const vector<double>& c,
+    vector<array<double, S>>& beta
+);
+
+
+/**
+ * @brief Posteriorna vjerojatnost da je model u jednom od stanja iz skupa
+ * (npr. "+" stanja modela s 8 stanja) za svaki t.
+ *
+ * Rezultat se može izravno predati islands_from_posterior.
+ *
+ * @param O Sekvenca opažanja (simboli 0..K-1)
+ * @param hmm HMM parametri
+ * @param in_set in_set[i] = true ako stanje i pripada skupu
+ * @param posterior Izlaz: posterior skupa za svaki t
+ *
+ * @return double Log-vjerojatnost sekvence
+ */
+template <int S, int K>
+double hmm_posterior(
+    ObsView O,
+    const HMMParams<S, K>& hmm,
+    const array<bool, S>& in_set,
+    vector<double>& posterior
+);
+
+
+/**
+ * @brief E-korak Baum-Welch algoritma za skup sekvenci uz maske dozvoljenih stanja.
+ *
+ * Gamma i xi računaju se istim formulama i provjerama kao expected_counts_batched.
+ * Sekvence kraće od 2 ili s log-vjerojatnošću koja nije konačna se preskaču.
+ *
+ * @param sequences Vektor sekvenci opažanja
+ * @param state_masks Vektor maski dozvoljenih stanja (bit po stanju) za svaku sekvencu
+ * @param hmm HMM parametri
+ * @param counts Očekivani brojevi (dodaju se na postojeće)
+ * @param ll Log-vjerojatnost (dodaju se log-vjerojatnosti korištenih sekvenci)
+ */
+template <int S, int K>
+void hmm_expected_counts(
+    const vector<ObsView>& sequences,
+    const vector<MaskView>& state_masks,
+    const HMMParams<S, K>& hmm,
+    ExpectedCountsT<S, K>& counts,
+    double& ll
+);
+
+
+/**
+ * @brief M-korak Baum-Welch algoritma: novi A i B iz očekivanih brojeva uz
+ * pseudo-brojeve i donju granicu emisija.
+ *
+ * @param counts Očekivani brojevi iz E-koraka
+ * @param hmm HMM model čiji se parametri ažuriraju
+ */
+template <int S, int K>
+void hmm_maximization_step(ExpectedCountsT<S, K> counts, HMMParams<S, K>& hmm);
+
+
+/**
+ * @brief Jedna iteracija Baum-Welch algoritma (E-korak i M-korak).
+ *
+ * @param sequences Vektor sekvenci opažanja
+ * @param state_masks Vektor maski dozvoljenih stanja (bit po stanju) za svaku sekvencu
+ * @param hmm HMM model čiji se parametri ažuriraju
+ * @param ll Referenca na log-vjerojatnost koja se ažurira
+ *
+ * @return double Ažurirana log-vjerojatnost svih sekvenci
+ */
+template <int S, int K>
+double hmm_baum_welch_iteration(
+    const vector<ObsView>& sequences,
+    const vector<MaskView>& state_masks,
+    HMMParams<S, K>& hmm,
+    double& ll
+);
+
+
+/**
+ * @brief Viterbi put (najvjerojatniji niz stanja) u log-prostoru.
+ *
+ * Traceback se pohranjuje kao jedan bajt po stanju po poziciji; za CpG model
+ * s bitovnim tracebackom vidi decode_islands_viterbi. Kod jednakih vrijednosti
+ * prednost ima stanje s manjim indeksom.
+ *
+ * @param O Sekvenca opažanja (simboli 0..K-1)
+ * @param hmm HMM parametri
+ *
+ * @return vector<uint8_t> Stanje za svaki t
+ */
+template <int S, int K>
+vector<uint8_t> hmm_viterbi(ObsView O, const HMMParams<S, K>& hmm);
@@ -0,0 +1,262 @@
+#include "./kstep_scorer.hpp"
+
+#include <cfloat>
+
+
+namespace {
+
+/**
+ * Svodi najveći element matrice u [1, 2); faktor ide u eksponent.
+ * Nul-matrica ostaje nepromijenjena.
+ */
+void normalize_matrix(ScaledMatrix& P) {
+    double mx = max(max(P.m[0][0], P.m[0][1]), max(P.m[1][0], P.m[1][1]));
+    if (!(mx > 0.0) || !isfinite(mx)) return;
+
+    int e;
+    frexp(mx, &e);
+    e -= 1;
+    for (int i = 0; i < NSTATE; i++) {
+        for (int j = 0; j < NSTATE; j++) P.m[i][j] = ldexp(P.m[i][j], -e);
+    }
+    P.exponent += e;
+}
+
+
+ScaledMatrix multiply(const ScaledMatrix& A, const ScaledMatrix& B) {
+    ScaledMatrix P;
+    for (int i = 0; i < NSTATE; i++) {
+        for (int j = 0; j < NSTATE; j++) P.m[i][j] = A.m[i][0] * B.m[0][j] + A.m[i][1] * B.m[1][j];
+    }
+    P.exponent = A.exponent + B.exponent;
+    normalize_matrix(P);
+    return P;
+}
+
+
+/**
+ * Matrica jednog koraka za simbol o: M[o] sa stupcima stanja koja maska ne dopušta postavljenima na 0.
+ */
+ScaledMatrix step_matrix(const TransferTable& tt, int o, int kind) {
+    ScaledMatrix P;
+    for (int i = 0; i < NSTATE; i++) {
+        for (int j = 0; j < NSTATE; j++) {
+            bool allowed = (kind == 0) || (kind == j + 1);
+            P.m[i][j] = allowed ? tt.M[o][i][j] : 0.0;
+        }
+    }
+    P.exponent = 0;
+    normalize_matrix(P);
+    return P;
+}
+
+
+/**
+ * Vrsta maske na poziciji: 0 = oba stanja, 1 = samo B, 2 = samo CpG, -1 = nijedno.
+ */
+inline int mask_kind(uint8_t m) {
+    bool b = (m & MASK_B) != 0;
+    bool c = (m & MASK_CPG) != 0;
+    return (b && c) ? 0 : b ? 1 : c ? 2 : -1;
+}
+
+
+/**
+ * Renormalizira (n0, n1) potencijom broja 2 tako da je suma u [1, 2);
+ * vraća false ako suma nije pozitivna i konačna.
+ */
+inline bool rescale(double n0, double n1, double& a0, double& a1, long long& exponent) {
+    double s = n0 + n1;
+    if (__builtin_expect(!(s > 0.0) || !(s <= DBL_MAX), 0)) return false;
+
+    uint64_t bits;
+    memcpy(&bits, &s, sizeof(bits));
+    int e = (int)((bits >> 52) & 0x7ff) - 1023;
+    uint64_t scale_bits = (uint64_t)(1023 - e) << 52;
+    double scale;
+    memcpy(&scale, &scale_bits, sizeof(scale));
+
+    a0 = n0 * scale;
+    a1 = n1 * scale;
+    exponent += e;
+    return true;
+}
+
+
+/**
+ * alpha <- alpha * P. Ako suma pukne, kao i u forward_scaled alpha se zamjenjuje
+ * maskom normaliziranom na dosadašnju sumu, bez doprinosa log-vjerojatnosti.
+ */
+inline void advance(const ScaledMatrix& P, int fallback_kind, double& a0, double& a1, long long& exponent) {
+    double n0 = a0 * P.m[0][0] + a1 * P.m[1][0];
+    double n1 = a0 * P.m[0][1] + a1 * P.m[1][1];
+    if (__builtin_expect(rescale(n0, n1, a0, a1, exponent), 1)) {
+        exponent += P.exponent;
+        return;
+    }
+
+    double s = a0 + a1;
+    a0 = (fallback_kind == 2) ? 0.0 : (fallback_kind == 1) ? s : 0.5 * s;
+    a1 = (fallback_kind == 1) ? 0.0 : (fallback_kind == 2) ? s : 0.5 * s;
+}
+
+
+inline uint64_t load64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+
+/**
+ * Duljina ponavljanja s periodom 2 od pozicije t (O[p] == O[p - 2] za p >= t + 2).
+ */
+int period2_run_length(ObsView O, int t) {
+    size_t T = O.size();
+    size_t p = (size_t)t + 2;
+    while (p + 8 <= T && load64(O.begin() + p) == load64(O.begin() + p - 2)) p += 8;
+    while (p < T && O[p] == O[p-2]) p++;
+    return (int)(p - (size_t)t);
+}
+
+
+double finish(double a0, double a1, long long exponent) {
+    return (double)exponent * M_LN2 + log(a0 + a1);
+}
+
+} // namespace
+
+
+KStepScorer::KStepScorer(const HMM& hmm) {
+    rebuild(hmm);
+}
+
+
+void KStepScorer::rebuild(const HMM& hmm) {
+    tt = make_transfer_table(hmm);
+
+    step1.resize(MASK_KINDS * NSYM);
+    for (int kind = 0; kind < MASK_KINDS; kind++) {
+        for (int o = 0; o < NSYM; o++) step1[kind * NSYM + o] = step_matrix(tt, o, kind);
+    }
+
+    step2.resize(NSYM * NSYM);
+    for (int o1 = 0; o1 < NSYM; o1++) {
+        for (int o2 = 0; o2 < NSYM; o2++) step2[o1 * NSYM + o2] = multiply(step1[o1], step1[o2]);
+    }
+
+    step3.resize(MASK_KINDS * NSYM * NSYM * NSYM);
+    for (int kind = 0; kind < MASK_KINDS; kind++) {
+        const ScaledMatrix* S = &step1[kind * NSYM];
+        ScaledMatrix* out = &step3[kind * NSYM * NSYM * NSYM];
+        for (int o1 = 0; o1 < NSYM; o1++) {
+            for (int o2 = 0; o2 < NSYM; o2++) {
+                ScaledMatrix P12 = multiply(S[o1], S[o2]);
+                for (int o3 = 0; o3 < NSYM; o3++) out[(o1 * NSYM + o2) * NSYM + o3] = multiply(P12, S[o3]);
+            }
+        }
+    }
+
+    run_pow.resize(NSYM * NSYM * KSTEP_RUN_LEVELS);
+    for (int q = 0; q < NSYM * NSYM; q++) {
+        ScaledMatrix* levels = &run_pow[q * KSTEP_RUN_LEVELS];
+        levels[0] = step2[q];
+        for (int k = 1; k < KSTEP_RUN_LEVELS; k++) levels[k] = multiply(levels[k-1], levels[k-1]);
+    }
+}
+
+
+/**
+ * Primjenjuje (M[O[t]] * M[O[t+1]])^(len / 2) binarnim potencijama.
+ * Vraća broj obrađenih opažanja (paran).
+ */
+int KStepScorer::skip_run(ObsView O, int t, int len, double& a0, double& a1, long long& exponent) const {
+    long long n = len / 2;
+    const ScaledMatrix* levels = &run_pow[(O[t] * NSYM + O[t+1]) * KSTEP_RUN_LEVELS];
+
+    for (int k = 0; k < KSTEP_RUN_LEVELS; k++) {
+        if ((n >> k) & 1) advance(levels[k], 0, a0, a1, exponent);
+    }
+    // (2^KSTEP_RUN_LEVELS parova) = najviša razina dvaput
+    for (long long h = n >> KSTEP_RUN_LEVELS; h > 0; h--) {
+        advance(levels[KSTEP_RUN_LEVELS - 1], 0, a0, a1, exponent);
+        advance(levels[KSTEP_RUN_LEVELS - 1], 0, a0, a1, exponent);
+    }
+    return (int)(2 * n);
+}
+
+
+double KStepScorer::loglik(ObsView O) const {
+    int T = (int)O.size();
+    if (T == 0) return 0.0;
+
+    double a0 = 0.5, a1 = 0.5;
+    long long exponent = 0;
+    rescale(tt.start[O[0]][0], tt.start[O[0]][1], a0, a1, exponent);
+
+    int t = 1;
+    while (t < T) {
+        // brza provjera: 10 opažanja s periodom 2, pa tek onda mjerenje duljine
+        if (t + KSTEP_RUN_MIN <= T && load64(O.begin() + t) == load64(O.begin() + t + 2)) {
+            int len = period2_run_length(O, t);
+            if (len >= KSTEP_RUN_MIN) {
+                t += skip_run(O, t, len, a0, a1, exponent);
+                continue;
+            }
+        }
+
+        if (t + 3 <= T) {
+            advance(step3[(O[t] * NSYM + O[t+1]) * NSYM + O[t+2]], 0, a0, a1, exponent);
+            t += 3;
+        } else if (t + 2 <= T) {
+            advance(step2[O[t] * NSYM + O[t+1]], 0, a0, a1, exponent);
+            t += 2;
+        } else {
+            advance(step1[O[t]], 0, a0, a1, exponent);
+            t += 1;
+        }
+    }
+
+    return finish(a0, a1, exponent);
+}
+
+
+double KStepScorer::loglik_masked(ObsView O, MaskView state_mask) const {
+    int T = (int)O.size();
+    if (T == 0) return 0.0;
+
+    const int GROUP = NSYM * NSYM * NSYM;
+
+    double a0 = 0.5, a1 = 0.5;
+    long long exponent = 0;
+    {
+        int kind = mask_kind(state_mask[0]);
+        double n0 = tt.start[O[0]][0] * mask_allows(state_mask[0], 0);
+        double n1 = tt.start[O[0]][1] * mask_allows(state_mask[0], 1);
+        if (!rescale(n0, n1, a0, a1, exponent)) {
+            a0 = (kind == 2) ? 0.0 : (kind == 1) ? 1.0 : 0.5;
+            a1 = (kind == 1) ? 0.0 : (kind == 2) ? 1.0 : 0.5;
+        }
+    }
+
+    int t = 1;
+    while (t < T) {
+        int kind = mask_kind(state_mask[t]);
+
+        if (kind >= 0 && t + 3 <= T && mask_kind(state_mask[t+1]) == kind && mask_kind(state_mask[t+2]) == kind) {
+            advance(step3[kind * GROUP + (O[t] * NSYM + O[t+1]) * NSYM + O[t+2]], kind, a0, a1, exponent);
+            t += 3;
+        } else if (kind >= 0) {
+            advance(step1[kind * NSYM + O[t]], kind, a0, a1, exponent);
+            t += 1;
+        } else {
+            // nijedno stanje nije dozvoljeno: alpha je 0, pa forward_scaled uzima uniformnu
+            double s = a0 + a1;
+            a0 = 0.5 * s;
+            a1 = 0.5 * s;
+            t += 1;
+        }
+    }
+
+    return finish(a0, a1, exponent);
+}
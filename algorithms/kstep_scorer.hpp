@@ -0,0 +1,92 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <cstdint>
+
+#include "../utils/structs_consts_functions.hpp"
+#include "./forward_backward.hpp"
+
+using namespace std;
+
+
+/**
+ * 2x2 matrica sa zasebnim binarnim eksponentom: vrijednost je m * 2^exponent,
+ * a m je normalizirana tako da je najveći element u [1, 2).
+ */
+struct ScaledMatrix {
+    double m[NSTATE][NSTATE];
+    int exponent;
+};
+
+
+/**
+ * Broj razina potencija matrica za ponavljanja (2^k parova opažanja, k < KSTEP_RUN_LEVELS).
+ */
+constexpr int KSTEP_RUN_LEVELS = 20;
+
+/**
+ * Najkraće ponavljanje (u opažanjima) koje se preskače potencijama umjesto trojkama.
+ */
+constexpr int KSTEP_RUN_MIN = 32;
+
+
+/**
+ * @brief Računanje log-vjerojatnosti sekvence forward rekurzijom po k koraka.
+ *
+ * S 16 simbola i dva stanja svaki k-gram opažanja ima fiksan 2x2 produkt
+ * prijelaznih matrica M[o1] * ... * M[ok]. Tablice produkata za parove (256)
+ * i trojke (4096) grade se jednom po modelu, pa forward napreduje tri koraka
+ * po jednom dohvatu iz tablice. Umjesto dijeljenja skalirajućim faktorom alpha
+ * se renormalizira potencijom broja 2 (egzaktno), a eksponenti se zbrajaju.
+ *
+ * Ponavljanja s periodom 1 ili 2 opažanja (homopolimeri i dinukleotidna
+ * ponavljanja) duža od KSTEP_RUN_MIN preskaču se binarnim potencijama
+ * produkta para, O(log n) umjesto O(n) koraka.
+ *
+ * Rezultat odgovara forward_scaled / forward_scaled_masked do zaokruživanja.
+ * Nakon promjene parametara modela tablice se ponovno grade s rebuild().
+ */
+class KStepScorer {
+public:
+    KStepScorer() = default;
+
+    explicit KStepScorer(const HMM& hmm);
+
+    /**
+     * @brief Ponovno gradi tablice za nove parametre modela.
+     */
+    void rebuild(const HMM& hmm);
+
+    /**
+     * @brief Log-vjerojatnost sekvence (forward bez maske).
+     *
+     * @param O Sekvenca opažanja
+     * @return double Log-vjerojatnost sekvence (0 za praznu sekvencu)
+     */
+    double loglik(ObsView O) const;
+
+    /**
+     * @brief Log-vjerojatnost sekvence uz masku dozvoljenih stanja (bit po stanju) po t.
+     *
+     * Trojke unutar kojih je maska ista (oba stanja, samo B ili samo CpG)
+     * koriste tablice, a ostali koraci idu jedan po jedan.
+     *
+     * @param O Sekvenca opažanja
+     * @param state_mask Maska dozvoljenih stanja (bit po stanju) za svaki t
+     * @return double Log-vjerojatnost sekvence (0 za praznu sekvencu)
+     */
+    double loglik_masked(ObsView O, MaskView state_mask) const;
+
+private:
+    // vrste maske: 0 = oba stanja, 1 = samo B, 2 = samo CpG
+    static constexpr int MASK_KINDS = 3;
+
+    TransferTable tt;
+    vector<ScaledMatrix> step1;    // [kind][o]
+    vector<ScaledMatrix> step2;    // [o1 * 16 + o2]
+    vector<ScaledMatrix> step3;    // [kind][o1 * 256 + o2 * 16 + o3]
+    vector<ScaledMatrix> run_pow;  // [o1 * 16 + o2][k] = (M[o1] * M[o2])^(2^k)
+
+    int skip_run(ObsView O, int t, int len, double& a0, double& a1, long long& exponent) const;
+};
@@ -0,0 +1,333 @@
+#include "./parallel_scan.hpp"
+#include "./two_state_kernel.hpp"
+
+#include <cfloat>
+
+
+namespace {
+
+/**
+ * Blok [s, e) jedne sekvence. prod je normalizirani produkt matrica koraka
+ * S_t[i][j] = A[i][j] * B[j][O_t] * m_t[j] za t u bloku (za prvi blok od t = 1);
+ * alpha_in je alpha[s - 1], a beta_out beta[e - 1], obje normalizirane.
+ */
+template <class Real>
+struct ScanBlock {
+    int seq;
+    int s;
+    int e;
+    Real prod[NSTATE][NSTATE];
+    Real alpha_in[NSTATE];
+    Real beta_out[NSTATE];
+};
+
+
+template <class Real>
+void make_blocks(const vector<ObsView>& sequences, size_t min_len, vector<ScanBlock<Real>>& blocks) {
+    for (size_t k = 0; k < sequences.size(); k++) {
+        int T = (int)sequences[k].size();
+        if ((size_t)T < min_len) continue;
+        for (int s = 0; s < T; s += SCAN_CHUNK) {
+            ScanBlock<Real> b{};
+            b.seq = (int)k;
+            b.s = s;
+            b.e = min(T, s + SCAN_CHUNK);
+            blocks.push_back(b);
+        }
+    }
+}
+
+
+/**
+ * Korak 1: produkt matrica koraka bloka, normaliziran svakih 8 koraka
+ * (skala produkta nije bitna jer se granice normaliziraju).
+ */
+template <class Mask, class Real>
+void block_product(ObsView O, const RealTable<Real>& tt, const Mask& mask, ScanBlock<Real>& b) {
+    Real p00 = 1, p01 = 0, p10 = 0, p11 = 1;
+    for (int t = max(b.s, 1); t < b.e; t++) {
+        const Real (*M)[NSTATE] = tt.M[O[t]];
+        Real m0 = (Real)mask.at(t, 0);
+        Real m1 = (Real)mask.at(t, 1);
+        Real s00 = M[0][0] * m0, s01 = M[0][1] * m1;
+        Real s10 = M[1][0] * m0, s11 = M[1][1] * m1;
+
+        Real n00 = p00 * s00 + p01 * s10;
+        Real n01 = p00 * s01 + p01 * s11;
+        Real n10 = p10 * s00 + p11 * s10;
+        Real n11 = p10 * s01 + p11 * s11;
+        p00 = n00; p01 = n01; p10 = n10; p11 = n11;
+
+        if ((t & 7) == 0) {
+            Real sum = p00 + p01 + p10 + p11;
+            if (sum > 0) {
+                Real inv = 1 / sum;
+                p00 *= inv; p01 *= inv; p10 *= inv; p11 *= inv;
+            }
+        }
+    }
+    b.prod[0][0] = p00; b.prod[0][1] = p01;
+    b.prod[1][0] = p10; b.prod[1][1] = p11;
+}
+
+
+/**
+ * Korak 2: granice blokova jedne sekvence (blokovi [first, last)).
+ * alpha[e - 1] = alpha[s - 1] * prod, beta[s - 1] = prod * beta[e - 1].
+ */
+template <class Mask, class Real>
+void block_boundaries(ObsView O, const RealTable<Real>& tt, const Mask& mask,
+                      ScanBlock<Real>* blocks, int n) {
+    int T = (int)O.size();
+
+    Real a0, a1;
+    forward_start(O, tt, mask, a0, a1);
+    for (int k = 0; k < n; k++) {
+        ScanBlock<Real>& b = blocks[k];
+        b.alpha_in[0] = a0;
+        b.alpha_in[1] = a1;
+        Real n0 = a0 * b.prod[0][0] + a1 * b.prod[1][0];
+        Real n1 = a0 * b.prod[0][1] + a1 * b.prod[1][1];
+        normalize(mask, b.e - 1, n0, n1);
+        a0 = n0;
+        a1 = n1;
+    }
+
+    Real b0 = (Real)mask.at(T - 1, 0);
+    Real b1 = (Real)mask.at(T - 1, 1);
+    normalize(mask, T - 1, b0, b1);
+    for (int k = n - 1; k >= 0; k--) {
+        ScanBlock<Real>& b = blocks[k];
+        b.beta_out[0] = b0;
+        b.beta_out[1] = b1;
+        if (k == 0) break;
+        Real n0 = b.prod[0][0] * b0 + b.prod[0][1] * b1;
+        Real n1 = b.prod[1][0] * b0 + b.prod[1][1] * b1;
+        normalize(mask, b.s - 1, n0, n1);
+        b0 = n0;
+        b1 = n1;
+    }
+}
+
+
+/**
+ * Korak 3 (zajednički dio): beta bloka od beta_out unatrag, normalizirana po
+ * koraku. Posterior, gamma i xi su omjeri pa skala po t ne utječe na rezultat.
+ */
+template <class Mask, class Real>
+void block_beta(ObsView O, const RealTable<Real>& tt, const Mask& mask, const ScanBlock<Real>& b,
+                vector<array<Real, NSTATE>>& beta) {
+    beta.resize(b.e - b.s);
+    Real b0 = b.beta_out[0];
+    Real b1 = b.beta_out[1];
+    beta[b.e - 1 - b.s] = {b0, b1};
+    for (int t = b.e - 2; t >= b.s; t--) {
+        backward_step(O, tt, mask, t, (Real)1, b0, b1);
+        normalize(mask, t, b0, b1);
+        beta[t - b.s] = {b0, b1};
+    }
+}
+
+
+/**
+ * alpha[t] unutar bloka: za t = 0 početni produkti, za t = s nastavak iz alpha_in.
+ */
+template <class Mask, class Real>
+inline Real block_forward_step(ObsView O, const RealTable<Real>& tt, const Mask& mask,
+                               const ScanBlock<Real>& b, int t, Real& a0, Real& a1) {
+    if (t == 0) return forward_start(O, tt, mask, a0, a1);
+    if (t == b.s) {
+        a0 = b.alpha_in[0];
+        a1 = b.alpha_in[1];
+    }
+    return forward_step(O, tt, mask, t, a0, a1);
+}
+
+
+template <class Real>
+double posterior_block(ObsView O, const RealTable<Real>& tt, const ScanBlock<Real>& b, Real* posterior) {
+    const NoMask mask;
+    vector<array<Real, NSTATE>> beta;
+    block_beta(O, tt, mask, b, beta);
+
+    LogScaleAccumulator acc;
+    Real a0 = 0, a1 = 0;
+    for (int t = b.s; t < b.e; t++) {
+        acc.add(block_forward_step(O, tt, mask, b, t, a0, a1));
+
+        const array<Real, NSTATE>& bt = beta[t - b.s];
+        Real norm = 0;
+        norm += a0 * bt[0];
+        norm += a1 * bt[1];
+        posterior[t] = (norm > 0) ? (a1 * bt[1]) / norm : 0;
+    }
+    return -acc.log();
+}
+
+
+inline bool valid_den(double x) {
+    return isfinite(x) && x > 0.0;
+}
+
+
+/**
+ * E-korak bloka: gamma za t u [s, e) i xi za prijelaze (t-1 -> t) s t u bloku,
+ * uz iste formule i provjere kao expected_counts_batched.
+ */
+double counts_block(ObsView O, const RealTable<lattice_t>& tt, const HMM& hmm,
+                    MaskView mask_v, const ScanBlock<lattice_t>& b,
+                    ExpectedCounts& counts) {
+    const StateMask mask{mask_v};
+    const int T = (int)O.size();
+
+    vector<array<lattice_t, NSTATE>> beta;
+    block_beta(O, tt, mask, b, beta);
+
+    LogScaleAccumulator acc;
+    lattice_t a0 = 0, a1 = 0;
+    double ap[NSTATE] = {b.alpha_in[0], b.alpha_in[1]};   // alpha[t-1]
+    double bp[NSTATE] = {0.0, 0.0};                       // beta[t-1]
+
+    for (int t = b.s; t < b.e; t++) {
+        acc.add(block_forward_step(O, tt, mask, b, t, a0, a1));
+
+        const double at[NSTATE] = {a0, a1};
+        const double bt[NSTATE] = {beta[t - b.s][0], beta[t - b.s][1]};
+        const int sym = O[t];
+
+        // xi za prijelaz t-1 -> t (za t = s alpha[s-1] i beta[s-1] su granice bloka)
+        if (t > 0) {
+            if (t == b.s) {
+                // beta[s-1] pripada prethodnom bloku: jedan korak unatrag iz beta[s]
+                double w[NSTATE];
+                for (int j = 0; j < NSTATE; j++) w[j] = hmm.B[j][sym] * mask.at(t, j) * bt[j];
+                for (int i = 0; i < NSTATE; i++) bp[i] = hmm.A[i][0] * w[0] + hmm.A[i][1] * w[1];
+            }
+
+            double xi_term[NSTATE][NSTATE];
+            double xi_den = 0.0;
+            for (int i = 0; i < NSTATE; i++) {
+                for (int j = 0; j < NSTATE; j++) {
+                    xi_term[i][j] = ap[i] * hmm.A[i][j] * hmm.B[j][sym] * mask.at(t, j) * bt[j];
+                    xi_den += xi_term[i][j];
+                }
+            }
+            double gamma_den = ap[0] * bp[0] + ap[1] * bp[1];
+            if (!valid_den(xi_den)) xi_den = 1e-300;
+            if (!valid_den(gamma_den)) gamma_den = 1e-300;
+
+            for (int i = 0; i < NSTATE; i++) {
+                double gamma = (ap[i] * bp[i]) / gamma_den;
+                if (!isfinite(gamma) || gamma < 0.0) continue;
+                for (int j = 0; j < NSTATE; j++) {
+                    double xi = xi_term[i][j] / xi_den;
+                    if (!isfinite(xi) || xi < 0.0) continue;
+                    counts.A_num[i][j] += xi;
+                }
+            }
+        }
+
+        double gamma_den = at[0] * bt[0] + at[1] * bt[1];
+        if (!valid_den(gamma_den)) gamma_den = 1e-300;
+        for (int i = 0; i < NSTATE; i++) {
+            double gamma = (at[i] * bt[i]) / gamma_den;
+            if (!isfinite(gamma) || gamma < 0.0) continue;
+            if (t < T - 1) counts.A_den[i] += gamma;
+            counts.B_den[i] += gamma;
+            counts.B_num[i][sym] += gamma;
+        }
+
+        for (int i = 0; i < NSTATE; i++) {
+            ap[i] = at[i];
+            bp[i] = bt[i];
+        }
+    }
+    return -acc.log();
+}
+
+} // namespace
+
+
+template <class Real>
+double posterior_parallel(ObsView O, const HMM& hmm, ThreadPool& pool, vector<Real>& posterior) {
+    const RealTable<Real> tt(make_transfer_table(hmm));
+    const NoMask mask;
+
+    int T = (int)O.size();
+    posterior.assign(T, 0);
+    if (T == 0) return 0.0;
+
+    vector<ObsView> one = {O};
+    vector<ScanBlock<Real>> blocks;
+    make_blocks(one, 1, blocks);
+
+    pool.parallel_for(blocks.size(), [&](size_t k) { block_product(O, tt, mask, blocks[k]); });
+    block_boundaries(O, tt, mask, blocks.data(), (int)blocks.size());
+
+    vector<double> block_ll(blocks.size());
+    pool.parallel_for(blocks.size(), [&](size_t k) {
+        block_ll[k] = posterior_block(O, tt, blocks[k], posterior.data());
+    });
+
+    double ll = 0.0;
+    for (double x : block_ll) ll += x;
+    return ll;
+}
+
+template double posterior_parallel<float>(ObsView, const HMM&, ThreadPool&, vector<float>&);
+template double posterior_parallel<double>(ObsView, const HMM&, ThreadPool&, vector<double>&);
+
+
+void expected_counts_parallel(
+    const vector<ObsView>& sequences,
+    const vector<MaskView>& state_masks,
+    const HMM& hmm,
+    ThreadPool& pool,
+    ExpectedCounts& counts,
+    double& ll
+) {
+    const RealTable<lattice_t> tt(make_transfer_table(hmm));
+
+    vector<ScanBlock<lattice_t>> blocks;
+    make_blocks(sequences, 2, blocks);
+    if (blocks.empty()) return;
+
+    pool.parallel_for(blocks.size(), [&](size_t k) {
+        ScanBlock<lattice_t>& b = blocks[k];
+        block_product(sequences[b.seq], tt, StateMask{state_masks[b.seq]}, b);
+    });
+
+    // granice su slijedne samo po blokovima jedne sekvence
+    for (size_t first = 0; first < blocks.size();) {
+        size_t last = first;
+        while (last < blocks.size() && blocks[last].seq == blocks[first].seq) last++;
+        int k = blocks[first].seq;
+        block_boundaries(sequences[k], tt, StateMask{state_masks[k]}, &blocks[first], (int)(last - first));
+        first = last;
+    }
+
+    vector<ExpectedCounts> block_counts(blocks.size());
+    vector<double> block_ll(blocks.size());
+    pool.parallel_for(blocks.size(), [&](size_t k) {
+        const ScanBlock<lattice_t>& b = blocks[k];
+        block_ll[k] = counts_block(sequences[b.seq], tt, hmm, state_masks[b.seq], b, block_counts[k]);
+    });
+
+    // zbraja se redom blokova; sekvenca čija log-vjerojatnost nije konačna se preskače
+    for (size_t first = 0; first < blocks.size();) {
+        size_t last = first;
+        double seq_ll = 0.0;
+        ExpectedCounts seq_counts;
+        while (last < blocks.size() && blocks[last].seq == blocks[first].seq) {
+            seq_ll += block_ll[last];
+            seq_counts.add(block_counts[last]);
+            last++;
+        }
+        if (isfinite(seq_ll)) {
+            ll += seq_ll;
+            seq_counts.used_sequences = 1;
+            counts.add(seq_counts);
+        }
+        first = last;
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include <array>
+
+#include "../utils/structs_consts_functions.hpp"
+#include "../utils/thread_pool.hpp"
+#include "./forward_backward.hpp"
+#include "./batched_forward_backward.hpp"
+
+using namespace std;
+
+
+/**
+ * Duljina bloka paralelnog scana. Granice blokova ne ovise o broju dretvi,
+ * pa je rezultat isti za bilo koji broj dretvi.
+ */
+constexpr int SCAN_CHUNK = 1 << 16;
+
+
+/**
+ * @brief Posteriorne vjerojatnosti P(Z_t = CpG | O) za jednu dugu sekvencu,
+ * paralelno po vremenu.
+ *
+ * Korak forward rekurzije modela s dva stanja je 2x2 linearno preslikavanje,
+ * pa se sekvenca dijeli u blokove od SCAN_CHUNK koraka:
+ *  1. paralelno se računa normalizirani produkt matrica koraka svakog bloka
+ *  2. slijedno (po bloku, ne po koraku) se iz produkata dobivaju alpha na kraju
+ *     i beta na kraju svakog bloka
+ *  3. paralelno se za svaki blok provodi forward i backward od tih granica
+ *
+ * Rezultat je točan posterior cijele sekvence (bez preklapajućih prozora);
+ * od slijednog se razlikuje samo u zaokruživanju.
+ *
+ * @param O Sekvenca opažanja
+ * @param hmm HMM parametri
+ * @param pool Bazen dretvi
+ * @param posterior Izlaz: posterior CpG stanja za svaki t
+ *
+ * @return double Log-vjerojatnost sekvence
+ */
+template <class Real = lattice_t>
+double posterior_parallel(ObsView O, const HMM& hmm, ThreadPool& pool, vector<Real>& posterior);
+
+
+/**
+ * @brief E-korak Baum-Welch algoritma s paralelnim scanom po vremenu; blokovi
+ * svih sekvenci se obrađuju paralelno.
+ *
+ * Isti rezultat kao expected_counts_batched do zaokruživanja: gamma i xi se
+ * računaju istim formulama, a brojevi blokova se zbrajaju redom blokova.
+ *
+ * @param sequences Vektor sekvenci opažanja (dinukleotidi)
+ * @param state_masks Vektor maski dozvoljenih stanja (bit po stanju) za svaku sekvencu
+ * @param hmm HMM parametri
+ * @param pool Bazen dretvi
+ * @param counts Očekivani brojevi (dodaju se na postojeće)
+ * @param ll Log-vjerojatnost (dodaju se log-vjerojatnosti korištenih sekvenci)
+ */
+void expected_counts_parallel(
+    const vector<ObsView>& sequences,
+    const vector<MaskView>& state_masks,
+    const HMM& hmm,
+    ThreadPool& pool,
+    ExpectedCounts& counts,
+    double& ll
+);
@@ -0,0 +1,172 @@
+#include "./stream_decode.hpp"
+#include "./two_state_kernel.hpp"
+#include "../postprocesing/decoded_postprocesing.hpp"
+
+
+StreamDecoder::StreamDecoder(const HMM& hmm, int lag, double POST_ENTER, double POST_EXIT, double POST_TRIM)
+    : tt(make_transfer_table(hmm)),
+      lag(max(lag, 1)),
+      POST_ENTER(POST_ENTER),
+      POST_EXIT(POST_EXIT),
+      POST_TRIM(POST_TRIM),
+      ring(2 * (size_t)max(lag, 1)) {}
+
+
+void StreamDecoder::push(uint8_t symbol, long long first_pos, long long second_pos) {
+    // forward filtriranje istim koracima kao forward_step (bez maske)
+    const NoMask mask;
+    if (pushed == 0) {
+        a0 = tt.start[symbol][0];
+        a1 = tt.start[symbol][1];
+    } else {
+        const double (*M)[NSTATE] = tt.M[symbol];
+        double n0 = a0 * M[0][0] + a1 * M[1][0];
+        double n1 = a0 * M[0][1] + a1 * M[1][1];
+        a0 = n0;
+        a1 = n1;
+    }
+    normalize(mask, 0, a0, a1);
+
+    slot(pushed) = {a0, a1, first_pos, second_pos, symbol};
+    pushed++;
+
+    if (pushed - finalized == 2 * (long long)lag) smooth(lag);
+}
+
+
+/**
+ * Backward od najnovijeg opažanja do najstarijeg nefinaliziranog; posterior
+ * se pamti za count najstarijih pozicija i finalizira redom po t.
+ */
+void StreamDecoder::smooth(long long count) {
+    const NoMask mask;
+    const long long newest = pushed - 1;
+
+    posterior.resize((size_t)count);
+    double b0 = 1.0, b1 = 1.0;
+    normalize(mask, 0, b0, b1);
+
+    for (long long t = newest; t >= finalized; t--) {
+        if (t < newest) {
+            const double (*M)[NSTATE] = tt.M[slot(t + 1).symbol];
+            double n0 = M[0][0] * b0 + M[0][1] * b1;
+            double n1 = M[1][0] * b0 + M[1][1] * b1;
+            b0 = n0;
+            b1 = n1;
+            normalize(mask, 0, b0, b1);
+        }
+
+        if (t < finalized + count) {
+            const Slot& s = slot(t);
+            double norm = s.a0 * b0 + s.a1 * b1;
+            posterior[(size_t)(t - finalized)] = (norm > 0) ? (s.a1 * b1) / norm : 0.0;
+        }
+    }
+
+    for (long long i = 0; i < count; i++) finalize(finalized + i, posterior[(size_t)i]);
+    finalized += count;
+}
+
+
+void StreamDecoder::finalize(long long t, double p) {
+    const Slot& s = slot(t);
+
+    // histereza kao u decode_hysteresis
+    if (!in_cpg && p >= POST_ENTER) {
+        in_cpg = true;
+    } else if (in_cpg && p < POST_EXIT) {
+        in_cpg = false;
+        close_open();
+    }
+
+    // simbol = prva * 4 + druga baza (A=0, C=1, G=2, T=3)
+    ContentCounts next = counts;
+    next.c += (s.symbol & 3) == 1;
+    next.g += (s.symbol & 3) == 2;
+    next.cg += s.symbol == di_index('C', 'G');
+
+    // trim: otok ide od prve do zadnje pozicije s posteriorom >= POST_TRIM
+    if (in_cpg && !(p < POST_TRIM)) {
+        if (open.first < 0) {
+            open.first = t;
+            open.start_pos = s.first_pos;
+            open.before = counts;
+            open.first_base_c = (s.symbol >> 2) == 1;
+            open.first_base_g = (s.symbol >> 2) == 2;
+        }
+        open.last = t;
+        open.end_pos = s.second_pos;
+        open.after = next;
+    }
+    counts = next;
+
+    // otok na čekanju je gotov kad mu se novi otok više ne može pridružiti
+    if (pending.first >= 0 && t - pending.last - 1 > MERGE_DISTANCE &&
+        (open.first < 0 || open.first - pending.last - 1 > MERGE_DISTANCE)) {
+        emit_pending();
+    }
+}
+
+
+/**
+ * Zatvoreni otok se spaja s otokom na čekanju ako je razmak do MERGE_DISTANCE
+ * (kao filter_lenght_and_merge_close_islands), inače ga zamjenjuje.
+ */
+void StreamDecoder::close_open() {
+    if (open.first < 0) return;
+
+    if (pending.first >= 0 && open.first - pending.last - 1 <= MERGE_DISTANCE) {
+        pending.last = open.last;
+        pending.end_pos = open.end_pos;
+        pending.after = open.after;
+    } else {
+        emit_pending();
+        pending = open;
+    }
+    open = Candidate();
+}
+
+
+/**
+ * Filtar duljine i sadržaja (kao filter_lenght_and_merge_close_islands i
+ * filter_by_content) nad bazama otoka na čekanju.
+ */
+void StreamDecoder::emit_pending() {
+    if (pending.first < 0) return;
+
+    long long len = pending.last - pending.first + 2;
+    long long count_c = pending.first_base_c + pending.after.c - pending.before.c;
+    long long count_g = pending.first_base_g + pending.after.g - pending.before.g;
+    long long count_cg = pending.after.cg - pending.before.cg;
+
+    double gc_content = (count_c + count_g) / double(len);
+    double oe = 0.0;
+    if (count_c > 0 && count_g > 0) {
+        oe = (count_cg * double(len)) / (count_c * double(count_g));
+    }
+
+    if (len >= MIN_CPG_LEN && gc_content >= MIN_GC_CONTENT && oe >= MIN_CPG_OE) {
+        done.push_back({(int)pending.start_pos, (int)pending.end_pos, 0});
+    }
+    pending = Candidate();
+}
+
+
+void StreamDecoder::finish() {
+    if (pushed > finalized) smooth(pushed - finalized);
+    if (in_cpg) close_open();
+    emit_pending();
+
+    pushed = 0;
+    finalized = 0;
+    in_cpg = false;
+    open = Candidate();
+    counts = ContentCounts();
+}
+
+
+vector<CpgRegion> StreamDecoder::take_islands() {
+    vector<CpgRegion> out;
+    out.swap(done);
+    return out;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <cstdint>
+
+#include "../utils/structs_consts_functions.hpp"
+#include "./forward_backward.hpp"
+
+using namespace std;
+
+
+/**
+ * Zadani lag fixed-lag smoothinga (dinukleotidi): posterior pozicije t računa
+ * se s barem toliko opažanja iza t.
+ */
+constexpr int STREAM_DEFAULT_LAG = 50'000;
+
+
+/**
+ * @brief Dekodiranje CpG otoka iz toka opažanja uz fixed-lag smoothing.
+ *
+ * Forward filtriranje ide po opažanju čim stigne. Kad se u međuspremniku
+ * nakupi 2 * lag nefinaliziranih opažanja, backward prolaz (beta normalizirana
+ * po koraku, na kraju međuspremnika uniformna) ide od najnovijeg opažanja
+ * unatrag i finalizira posterior najstarijih lag pozicija; svaka pozicija tako
+ * ima između lag i 2 * lag opažanja budućnosti. Memorija je O(lag), a svako
+ * opažanje prolazi jedan forward i najviše dva backward koraka.
+ *
+ * Finalizirani posteriori odmah prolaze histerezu, trim po POST_TRIM, spajanje
+ * bliskih otoka, filtar duljine i sadržaja (iste granice kao
+ * filter_lenght_and_merge_close_islands i filter_by_content). Otok je gotov
+ * čim se iza njega finalizira MERGE_DISTANCE pozicija bez novog otoka.
+ *
+ * Koordinate otoka su originalne (1-based) pozicije prve i zadnje baze otoka,
+ * kako ih je dao pozivatelj u push().
+ */
+class StreamDecoder {
+public:
+    /**
+     * @param hmm Trenirani HMM model
+     * @param lag Najmanji broj opažanja budućnosti za posterior (>= 1)
+     * @param POST_ENTER Prag ulaska u CpG stanje (histerezis)
+     * @param POST_EXIT Prag izlaska iz CpG stanja (histerezis)
+     * @param POST_TRIM Prag posteriora za trimanje rubova CpG otoka
+     */
+    StreamDecoder(const HMM& hmm, int lag, double POST_ENTER, double POST_EXIT, double POST_TRIM);
+
+    /**
+     * @brief Dodaje sljedeće opažanje (dinukleotid) toka.
+     *
+     * @param symbol Dinukleotid (0..15, vidi di_index)
+     * @param first_pos Originalna pozicija prve baze dinukleotida
+     * @param second_pos Originalna pozicija druge baze dinukleotida
+     */
+    void push(uint8_t symbol, long long first_pos, long long second_pos);
+
+    /**
+     * @brief Kraj toka: finalizira preostale pozicije i zatvara otvorene otoke.
+     * Nakon finish() dekoder se može koristiti za novi tok (npr. sljedeći zapis).
+     */
+    void finish();
+
+    /**
+     * @brief Vraća i briše otoke završene od prethodnog poziva.
+     */
+    vector<CpgRegion> take_islands();
+
+private:
+    /**
+     * Brojevi C, G i CG (druga baza dinukleotida i par) za finalizirane pozicije,
+     * za sadržajni filtar otoka bez pohrane sekvence.
+     */
+    struct ContentCounts {
+        long long c = 0;
+        long long g = 0;
+        long long cg = 0;
+    };
+
+    struct Candidate {
+        long long first = -1;
+        long long last = -1;
+        long long start_pos = 0;
+        long long end_pos = 0;
+        ContentCounts before;
+        ContentCounts after;
+        int first_base_c = 0;
+        int first_base_g = 0;
+    };
+
+    struct Slot {
+        double a0;
+        double a1;
+        long long first_pos;
+        long long second_pos;
+        uint8_t symbol;
+    };
+
+    TransferTable tt;
+    int lag;
+    double POST_ENTER;
+    double POST_EXIT;
+    double POST_TRIM;
+
+    vector<Slot> ring;
+    vector<double> posterior;
+    long long pushed = 0;
+    long long finalized = 0;
+    double a0 = 0.0;
+    double a1 = 0.0;
+
+    bool in_cpg = false;
+    Candidate open;
+    Candidate pending;
+    ContentCounts counts;
+    vector<CpgRegion> done;
+
+    Slot& slot(long long t) { return ring[(size_t)(t % (long long)ring.size())]; }
+
+    void smooth(long long count);
+    void finalize(long long t, double p);
+    void close_open();
+    void emit_pending();
+};
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <limits>
+
+#include "./forward_backward.hpp"
+
+using namespace std;
+
+
+/**
+ * Zajednički koraci forward/backward rekurzije modela s dva stanja
+ * (forward_backward.cpp i spojeno dekodiranje u decode.cpp). Putevi koji
+ * koriste iste korake daju iste bitove.
+ *
+ * Prijelazni produkti u preciznosti latticea (za double samo kopija).
+ */
+template <class Real>
+struct RealTable {
+    Real M[NSYM][NSTATE][NSTATE];
+    Real start[NSYM][NSTATE];
+
+    explicit RealTable(const TransferTable& tt) {
+        for (int k = 0; k < NSYM; k++) {
+            for (int i = 0; i < NSTATE; i++) {
+                start[k][i] = (Real)tt.start[k][i];
+                for (int j = 0; j < NSTATE; j++) M[k][i][j] = (Real)tt.M[k][i][j];
+            }
+        }
+    }
+};
+
+
+/**
+ * Politike maske za zajednički kernel. NoMask vraća konstantu 1.0 pa se
+ * množenje maskom pri inlineanju potpuno uklanja.
+ */
+struct NoMask {
+    double at(int, int) const { return 1.0; }
+
+    template <class Real>
+    void fallback(int, Real& f0, Real& f1) const {
+        f0 = 0.5;
+        f1 = 0.5;
+    }
+};
+
+struct StateMask {
+    MaskView mask;
+
+    double at(int t, int j) const { return mask_allows(mask[t], j); }
+
+    // alpha kad suma pukne: maska normalizirana na 1 (ili uniformno ako je maska prazna)
+    template <class Real>
+    void fallback(int t, Real& f0, Real& f1) const {
+        double m0 = at(t, 0);
+        double m1 = at(t, 1);
+        double s = m0 + m1;
+        if (s <= 0.0) {
+            f0 = 0.5;
+            f1 = 0.5;
+        } else {
+            f0 = (Real)(m0 / s);
+            f1 = (Real)(m1 / s);
+        }
+    }
+};
+
+
+/**
+ * Normalizira (a0, a1) i vraća skalirajući faktor. U uobičajenom slučaju nema
+ * grananja ovisnog o podacima; fallback (suma 0 ili nije finite) je rijedak.
+ */
+template <class Mask, class Real>
+inline Real normalize(const Mask& mask, int t, Real& a0, Real& a1) {
+    Real s = a0 + a1;
+    bool ok = (s > 0) & (s <= numeric_limits<Real>::max());
+    Real ct = 1 / s;
+    ct = (ct > scale_limit<Real>()) ? scale_limit<Real>() : ct;
+    a0 *= ct;
+    a1 *= ct;
+    if (__builtin_expect(!ok, 0)) {
+        mask.fallback(t, a0, a1);
+        ct = 1;
+    }
+    return ct;
+}
+
+
+/**
+ * Jedan korak forward rekurzije (t = 0 iz početnih produkata, inače iz alpha[t-1]).
+ */
+template <class Mask, class Real>
+inline Real forward_start(ObsView O, const RealTable<Real>& tt, const Mask& mask, Real& a0, Real& a1) {
+    const Real* s = tt.start[O[0]];
+    a0 = s[0] * (Real)mask.at(0, 0);
+    a1 = s[1] * (Real)mask.at(0, 1);
+    return normalize(mask, 0, a0, a1);
+}
+
+template <class Mask, class Real>
+inline Real forward_step(ObsView O, const RealTable<Real>& tt, const Mask& mask, int t, Real& a0, Real& a1) {
+    const Real (*M)[NSTATE] = tt.M[O[t]];
+    Real n0 = (a0 * M[0][0] + a1 * M[1][0]) * (Real)mask.at(t, 0);
+    Real n1 = (a0 * M[0][1] + a1 * M[1][1]) * (Real)mask.at(t, 1);
+    Real ct = normalize(mask, t, n0, n1);
+    a0 = n0;
+    a1 = n1;
+    return ct;
+}
+
+
+/**
+ * Jedan korak backward rekurzije: beta[t] iz beta[t+1] (na mjestu) i c[t].
+ */
+template <class Mask, class Real>
+inline void backward_step(ObsView O, const RealTable<Real>& tt, const Mask& mask, int t, Real ct, Real& b0, Real& b1) {
+    const Real (*M)[NSTATE] = tt.M[O[t+1]];
+    Real w0 = (Real)mask.at(t+1, 0) * b0;
+    Real w1 = (Real)mask.at(t+1, 1) * b1;
+    Real n0 = (M[0][0] * w0 + M[0][1] * w1) * ct;
+    Real n1 = (M[1][0] * w0 + M[1][1] * w1) * ct;
+    b0 = n0;
+    b1 = n1;
+}
+
+
+/**
+ * @brief Razmak checkpointa K za sekvencu duljine T uz budžet radne memorije
+ * (bajtovi, 0 = sqrt(T)) i bytes_per_step bajtova pohrane po koraku.
+ */
+int checkpoint_interval(int T, size_t bytes_per_step, size_t memory_budget);
@@ -3,8 +3,12 @@
 #include "../hmm/hmm.hpp"
 #include "../postprocesing/decoded_postprocesing.hpp"
 #include "../evaluation/evaluation.hpp"
+#include "../genome/dinuc_cache.hpp"
+#include "../genome/workspace_manifest.hpp"
 #include "../utils/structs_consts_functions.hpp"
 
+#include <sstream>
+
 
 // Windowing parametri (dinukleotidi)
 const int WINDOW = 5'000'000;       // broj dinukleotida po prozoru
@@ -14,6 +18,31 @@ const double POST_ENTER = 0.60;
 const double POST_EXIT = 0.40;
 const double POST_TRIM = 0.42;
 
+/**
+ * @brief Čita opciju "--memory-budget MB". Ako je zadana, kromosom se dekodira
+ * u jednom prozoru s checkpointiranim forward-backwardom (točan posterior bez
+ * rubova prozora) uz taj budžet radne memorije.
+ *
+ * @return Budžet u bajtovima (0 ako opcija nije zadana)
+ */
+size_t parse_memory_budget_option(int argc, char* argv[]) {
+    size_t budget = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--memory-budget") != 0) continue;
+
+        char* end = nullptr;
+        long mb = (i + 1 < argc) ? strtol(argv[i + 1], &end, 10) : 0;
+        if (end == nullptr || *end != '\0' || mb < 1 || mb > 1'000'000) {
+            cerr << "Neispravan budžet memorije za --memory-budget (MB)" << endl;
+            exit(1);
+        }
+        budget = (size_t)mb << 20;
+        i++;
+    }
+    return budget;
+}
+
+
 /* 
  * @brief Predikcija CpG otoka pomoću treniranog HMM-a uz prozorsku obradu
  *        cijelog kromosoma i evaluaciju rezultata.
@@ -34,18 +63,53 @@ const double POST_TRIM = 0.42;
  *  - evaluiraju na razini otoka i baznih parova
  *
  * Parametri prozora (veličina, preklapanje) i pragovi posteriora
- * definirani su kao globalne konstante.
+ * definirani su kao globalne konstante. Uz "--memory-budget MB" cijeli
+ * kromosom je jedan prozor, a posterior se računa checkpointirano. Uz
+ * "--scan-threads N" (N > 1) cijeli kromosom je također jedan prozor, a
+ * posterior se računa paralelnim scanom po vremenu na N dretvi (ne može uz
+ * "--memory-budget", jer scan ne poštuje budžet). Uz "--viterbi"
+ * otoci se u istim prozorima dobivaju Viterbi putem umjesto posteriora i
+ * histereze (usporedba brzine i točnosti dvaju dekodiranja); ne može uz
+ * "--memory-budget" ni "--scan-threads". Uz "--threads N"
+ * prozori se obrađuju paralelno na N dretvi; otoci i ispis spajaju se redom po
+ * prozorima pa je rezultat isti kao serijski za bilo koji N.
  *
  * @note Koordinate CpG otoka su izražene u 1-based baznim koordinatama.
  * @note Dinukleotidni indeksi su 0-based.
  */
-int main() {
+int main(int argc, char* argv[]) {
+    const size_t memory_budget = parse_memory_budget_option(argc, argv);
+    const int scan_threads = parse_threads_option(argc, argv, 1, "--scan-threads");
+    const int window_threads = parse_threads_option(argc, argv, 1, "--threads");
+    bool viterbi = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--viterbi") == 0) viterbi = true;
+    }
+    // paralelni scan pohranjuje posterior cijelog kromosoma pa ne poštuje budžet
+    if (memory_budget > 0 && scan_threads > 1) {
+        cerr << "Opcije --memory-budget i --scan-threads ne mogu se koristiti zajedno" << endl;
+        exit(1);
+    }
+    // Viterbi se računa samo u prozorima: nije checkpointiran ni paralelan po vremenu
+    if (viterbi && (memory_budget > 0 || scan_threads > 1)) {
+        cerr << "Opcija --viterbi ne može se koristiti uz --memory-budget ili --scan-threads" << endl;
+        exit(1);
+    }
+    unique_ptr<ThreadPool> scan_pool;
+    if (scan_threads > 1) scan_pool.reset(new ThreadPool(scan_threads));
+
     HMM hmm = load_hmm("../output/trained_hmm_params.txt");
     if (hmm.chromosome < 17) hmm.chromosome = 17;
 
-    vector<int> O;
-    string s;
-    load_chr_seq_to_dinuc_vector(O, s, hmm.chromosome);
+    GenomeStore store;
+    open_genome_store_or_exit("../output/genome_store.bin", store, hmm.chromosome);
+    PackedSequence s = store.sequence(hmm.chromosome);
+    check_workspace("../output", store, hmm.chromosome);
+
+    // opažanja se mapiraju iz cache datoteke predobrade umjesto ponovnog kodiranja
+    DinucCache dinucs;
+    load_or_build_dinuc_cache("../output", store, hmm.chromosome, dinucs);
+    ObsView O = dinucs.observations();
 
     cout << "Učitana sekvenca za kromosom " << hmm.chromosome
          << " (baze=" << s.size()
@@ -55,16 +119,42 @@ int main() {
     predicted_all.reserve(20000);
 
     int T = (int)O.size();
-    for (int start_d = 0; start_d < T; start_d += STEP) {
-        int end_d = min(start_d + WINDOW, T);
-        int len_d = end_d - start_d;
-        if (len_d < 2) break;
-
-        auto islands = process_window(
-            O, s, hmm, start_d, end_d, T,
-            POST_ENTER, POST_EXIT, POST_TRIM, OVERLAP
-        );
+    const bool whole = memory_budget > 0 || scan_pool;
+    const int window = whole ? max(T, 1) : WINDOW;
+    const int step = whole ? window : STEP;
+
+    // prozori (start_d, end_d) redom po kromosomu
+    vector<pair<int, int>> windows;
+    for (int start_d = 0; start_d < T; start_d += step) {
+        int end_d = min(start_d + window, T);
+        if (end_d - start_d < 2) break;
+        windows.push_back({start_d, end_d});
+    }
+
+    // prozori su neovisni (rubovi se režu u keep_and_clip), pa se uz --threads
+    // obrađuju paralelno; otoci i ispis se spajaju redom po prozorima
+    vector<vector<CpgRegion>> window_islands(windows.size());
+    if (window_threads > 1 && windows.size() > 1) {
+        vector<ostringstream> window_log(windows.size());
+        ThreadPool pool(window_threads);
+        pool.parallel_for(windows.size(), [&](size_t w) {
+            window_islands[w] = process_window(
+                O, s, hmm, windows[w].first, windows[w].second, T,
+                POST_ENTER, POST_EXIT, POST_TRIM, OVERLAP, memory_budget, scan_pool.get(), viterbi,
+                window_log[w]
+            );
+        });
+        for (const auto& l : window_log) cout << l.str();
+    } else {
+        for (size_t w = 0; w < windows.size(); w++) {
+            window_islands[w] = process_window(
+                O, s, hmm, windows[w].first, windows[w].second, T,
+                POST_ENTER, POST_EXIT, POST_TRIM, OVERLAP, memory_budget, scan_pool.get(), viterbi
+            );
+        }
+    }
 
+    for (const auto& islands : window_islands) {
         predicted_all.insert(
             predicted_all.end(),
             islands.begin(),
@@ -72,9 +162,9 @@ int main() {
         );
     }
 
-    move_predicted_based_on_lowercase(predicted_all, hmm.chromosome);
+    move_predicted_based_on_lowercase(predicted_all, CoordinateMap(store.lowercase_regions(hmm.chromosome)));
 
-    vector<CpgRegion> true_islands = load_all_or_selected_coords(hmm.chromosome);
+    vector<CpgRegion> true_islands = load_all_or_selected_coords("../output", hmm.chromosome);
     
     island_based_evaluation(predicted_all, true_islands);
     base_pair_evaluation(predicted_all, true_islands);
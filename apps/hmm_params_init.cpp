@@ -1,6 +1,7 @@
 #include "../hmm/hmm.hpp"
 #include "../hmm/hmm_io.hpp"
 #include "../utils/structs_consts_functions.hpp"
+#include "../genome/workspace_manifest.hpp"
 
 /**
  * @brief Inicijalizacija parametara skrivenog Markovljevog modela (HMM).
@@ -19,8 +20,9 @@
  */
 int main() {
     vector<string> cpg = load_sequences("../output/clean_positive.txt");
-    string background = load_background("../output/clean_background.txt");
-    vector<CpgRegion> coords = load_all_or_selected_coords(1);
+    long long background[NSYM];
+    load_background_counts("../output/background_counts.txt", background);
+    vector<CpgRegion> coords = load_all_or_selected_coords("../output", 1);
 
     HMM hmm;
     double BB, BC, CC, CB;
@@ -28,12 +30,12 @@ int main() {
     compute_emission_pos(cpg, hmm.B[1]);      
     compute_emission_bg(background, hmm.B[0]); 
 
-    ifstream in("../output/1_train_chr.txt");
-    string chr_seq;
-    getline(in, chr_seq);
+    // treba nam samo duljina, koja je zapisana u manifestu predobrade
+    WorkspaceManifest manifest;
+    const ChromosomeManifest& chr1 = load_manifest_or_exit("../output", 1, manifest);
     // radi bolje preciznosti tranzicije računamo preko relativnog odnosa CpG otoka
     // u prvom kromosomu i ostatka genoma prvog kromosoma umjesto cijelog genoma
-    compute_transition_probabilities(coords, chr_seq.length(), BB, BC, CC, CB);
+    compute_transition_probabilities(coords, (int)chr1.compressed_length, BB, BC, CC, CB);
 
     hmm.A[0][0] = BB;
     hmm.A[0][1] = BC;
@@ -0,0 +1,152 @@
+#include "../algorithms/decode.hpp"
+#include "../hmm/hmm_io.hpp"
+#include "../hmm/hmm.hpp"
+#include "../genome/dinuc_cache.hpp"
+#include "../utils/structs_consts_functions.hpp"
+
+#include <iomanip>
+
+
+// isti prozori i pragovi kao u decode_and_evaluation
+const int WINDOW = 5'000'000;
+const int OVERLAP = 50'000;
+const int STEP = WINDOW - OVERLAP;
+const double POST_ENTER = 0.60;
+const double POST_EXIT = 0.40;
+const double POST_TRIM = 0.42;
+
+const int FIRST_CHR = 17;
+const int LAST_CHR = 22;
+
+
+/**
+ * Broj baza pokrivenih s oba skupa otoka (otoci unutar skupa se ne preklapaju).
+ */
+long long overlap_bp(vector<CpgRegion> a, vector<CpgRegion> b) {
+    auto by_start = [](const CpgRegion& x, const CpgRegion& y) { return x.start < y.start; };
+    sort(a.begin(), a.end(), by_start);
+    sort(b.begin(), b.end(), by_start);
+
+    long long bp = 0;
+    size_t i = 0, j = 0;
+    while (i < a.size() && j < b.size()) {
+        int s = max(a[i].start, b[j].start);
+        int e = min(a[i].end, b[j].end);
+        if (e >= s) bp += e - s + 1;
+        if (a[i].end < b[j].end) i++; else j++;
+    }
+    return bp;
+}
+
+
+long long total_bp(const vector<CpgRegion>& islands) {
+    long long bp = 0;
+    for (const auto& r : islands) bp += r.end - r.start + 1;
+    return bp;
+}
+
+
+/**
+ * @brief Usporedba float i double latticea na kromosomima za dekodiranje.
+ *
+ * Za svaki prozor (isti kao u decode_and_evaluation) računa se posterior i
+ * log-vjerojatnost u obje preciznosti, neovisno o PRECISION s kojim je program
+ * preveden. Ispisuju se razlika log-vjerojatnosti, najveća razlika posteriora,
+ * broj dinukleotida s različitim stanjem nakon histereze te otoci dobiveni
+ * iz oba posteriora (broj, identični otoci i preklapanje u baznim parovima).
+ * Uspoređuje se samo skalarni kernel dekodiranja: batched E-korak treninga
+ * računa rekurziju u double i u float načinu (float je samo pohranjeni lattice).
+ *
+ * Izvještaj se ispisuje i sprema u ../output/precision_report.txt.
+ */
+int main() {
+    HMM hmm = load_hmm("../output/trained_hmm_params.txt");
+
+    GenomeStore store;
+    if (!store.open("../output/genome_store.bin")) {
+        cerr << "Ne mogu otvoriti ../output/genome_store.bin\n";
+        exit(1);
+    }
+
+    ostringstream report;
+    report << "# float: rekurzija i lattice skalarnog kernela dekodiranja; batched E-korak treninga"
+           << " računa u double (float je samo pohranjeni lattice)\n";
+    report << "# kromosom  dinukleotidi  logL(double)  |dlogL|  max|dposterior|  razlicita_stanja"
+           << "  otoci(double)  otoci(float)  identicni  bp(double)  bp(float)  bp_preklapanje\n";
+    report << setprecision(6);
+
+    for (int chr = FIRST_CHR; chr <= LAST_CHR; chr++) {
+        if (store.entry(chr) == nullptr) continue;
+
+        PackedSequence s = store.sequence(chr);
+        DinucCache dinucs;
+        load_or_build_dinuc_cache("../output", store, chr, dinucs);
+        ObsView O = dinucs.observations();
+        int T = (int)O.size();
+
+        double ll64 = 0.0, ll32 = 0.0, max_diff = 0.0;
+        long long state_diff = 0;
+        vector<CpgRegion> islands64, islands32;
+
+        for (int start_d = 0; start_d < T; start_d += STEP) {
+            int end_d = min(start_d + WINDOW, T);
+            if (end_d - start_d < 2) break;
+            ObsView Oseg = O.sub(start_d, end_d - start_d);
+
+            {
+                vector<array<double, NSTATE>> alpha;
+                vector<double> c;
+                ll64 += forward_scaled(Oseg, hmm, alpha, c);
+            }
+            {
+                vector<array<float, NSTATE>> alpha;
+                vector<float> c;
+                ll32 += forward_scaled(Oseg, hmm, alpha, c);
+            }
+
+            vector<double> p64 = compute_posterior_c<double>(Oseg, hmm);
+            vector<float> p32 = compute_posterior_c<float>(Oseg, hmm);
+
+            vector<int> s64 = decode_hysteresis(p64, POST_ENTER, POST_EXIT);
+            vector<int> s32 = decode_hysteresis(p32, POST_ENTER, POST_EXIT);
+            for (size_t t = 0; t < p64.size(); t++) {
+                max_diff = max(max_diff, fabs(p64[t] - (double)p32[t]));
+                state_diff += (s64[t] != s32[t]);
+            }
+
+            auto w64 = islands_from_posterior(p64, s, start_d, end_d, T, POST_ENTER, POST_EXIT, POST_TRIM, OVERLAP);
+            auto w32 = islands_from_posterior(p32, s, start_d, end_d, T, POST_ENTER, POST_EXIT, POST_TRIM, OVERLAP);
+            islands64.insert(islands64.end(), w64.begin(), w64.end());
+            islands32.insert(islands32.end(), w32.begin(), w32.end());
+        }
+
+        size_t identical = 0;
+        for (const auto& a : islands64) {
+            for (const auto& b : islands32) {
+                if (a.start == b.start && a.end == b.end) {
+                    identical++;
+                    break;
+                }
+            }
+        }
+
+        report << chr << "  " << T << "  " << fixed << setprecision(3) << ll64
+               << "  " << scientific << setprecision(3) << fabs(ll64 - ll32)
+               << "  " << max_diff << defaultfloat
+               << "  " << state_diff
+               << "  " << islands64.size() << "  " << islands32.size() << "  " << identical
+               << "  " << total_bp(islands64) << "  " << total_bp(islands32)
+               << "  " << overlap_bp(islands64, islands32) << "\n";
+    }
+
+    cout << report.str();
+
+    ofstream out("../output/precision_report.txt");
+    if (!out) {
+        cerr << "Ne mogu zapisati ../output/precision_report.txt\n";
+        exit(1);
+    }
+    out << report.str();
+
+    return 0;
+}
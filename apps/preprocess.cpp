@@ -6,61 +6,102 @@
  *
  * Ova funkcija provodi cjelokupni postupak predobrade:
  * - Učitava poznate koordinate pozitivnih CpG otoka.
- * - Učitava i čisti pozadinsku (background) genomsku sekvencu.
- * - Dijeli genom na pojedinačne kromosome.
+ * - Broji dinukleotide pozadinske (background) genomske sekvence bez CpG otoka.
+ * - Dijeli genom na pojedinačne kromosome u jednom prolazu kroz FASTA fajl.
  * - Bilježi lowercase (maskirane) regije za svaki kromosom.
  * - Sprema per-kromosomske sekvence i pripadne metapodatke.
  *
  * Izlazne datoteke:
- *  - <chr>_train_chr.txt / <chr>_test_chr.txt :
- *      prvi red = sekvenca kromosoma (samo uppercase),
- *      sljedeći redovi = intervali lowercase regija (1-based)
+ *  - genome_store.bin :
+ *      binarni spremnik svih kromosoma (vidi genome/genome_store.hpp):
+ *      sekvenca (samo uppercase) pakirana na 2 bita po bazi,
+ *      N-regije i intervali lowercase regija (1-based); kromosomi 1-16
+ *      koriste se za treniranje, 17-22 za testiranje
+ *  - <chr>_dinuc.bin :
+ *      cache dinukleotidnih opažanja (uint8_t) po kromosomu
  *  - clean_positive.txt   : sekvence pozitivnih CpG otoka
- *  - clean_background.txt : pozadinski genom bez CpG regija
+ *  - background_counts.txt : brojevi dinukleotida pozadinskog genoma bez CpG regija
  *  - coords.txt           : koordinate CpG otoka (chr, start, end)
+ *  - cpg_index.bin        : binarni indeks CpG otoka sortiran po kromosomu i početku
+ *  - manifest.txt         : duljine, broj regija, checksumi i offseti po kromosomu
+ *                           (vidi genome/workspace_manifest.hpp)
+ *  - <genom>.fna.fai      : samtools indeks ulaznog genoma
  *
  * Ova aplikacija se pokreće jednom prije inicijalizacije i treniranja HMM-a.
  *
- * @note Putanje do datoteka su trenutno zadane u kodu (hardcoded).
+ * Opcija "--threads N" (zadano 1) uključuje paralelnu obradu: kromosomi nekomprimiranog
+ * genoma čitaju se iz mapirane datoteke preko .fai indeksa i obrađuju paralelno
+ * (vidi split_genome_parallel), a cache datoteke opažanja grade se paralelno.
+ * Isti broj dretvi koristi se za dekompresiju BGZF ulaza (uz N = 1 serijski).
+ * Izlazne datoteke su identične serijskom pokretanju.
+ *
+ * @note Putanje do datoteka su trenutno zadane u kodu (hardcoded). Ako nekomprimirana
+ *       datoteka ne postoji, koristi se ista putanja s nastavkom .gz (gzip ili BGZF).
  */
-int main() {
+int main(int argc, char* argv[]) {
     const string output_dir = "../output";
-    const string genome_path = "../data/ncbi_dataset/ncbi_dataset/data/GCF_009914755.1/GCF_009914755.1_T2T-CHM13v2.0_genomic.fna";
+    // ulazne datoteke mogu biti i komprimirane (.gz, gzip ili BGZF)
+    const string genome_path = resolve_input_path("../data/ncbi_dataset/ncbi_dataset/data/GCF_009914755.1/GCF_009914755.1_T2T-CHM13v2.0_genomic.fna");
+    const string positive_path = resolve_input_path("../data/test.txt");
     const int NUM_CHROMOSOMES = 22;
-    
-    string background;
+    const int threads = parse_threads_option(argc, argv);
+    ThreadPool pool(threads);
+
     vector<CpgRegion> coords;
-    vector<string> positive_cpg = load_positive_cpg("../data/test.txt", coords);
-    background = load_background(genome_path, coords);
+    vector<string> positive_cpg = load_positive_cpg(positive_path, coords, threads);
 
-    vector<ofstream> chromosome_out_files;
+    GenomeStoreWriter genome_store;
     ofstream out1, out2, coords_out;
-    open_output_files(NUM_CHROMOSOMES, output_dir, chromosome_out_files, out1, out2, coords_out);
-
-    long chromosome_length = 0;
-    for (int chr = 1; chr <= NUM_CHROMOSOMES; chr++) {
-        vector<lowerCaseRegions> lowercaseCoords;
-        string chromosome = load_chromosome(genome_path, lowercaseCoords, chr);
+    open_output_files(NUM_CHROMOSOMES, output_dir, genome_store, out1, out2, coords_out);
 
-        cout << "Duzina kromosoma " << chr << ": " << chromosome.size() << endl;
+    // jedan prolaz kroz genom: kromosomi, lowercase regije i pozadina odjednom
+    BackgroundCounter background(coords);
+    vector<long> chromosome_lengths;
+    vector<FaiRecord> fai_records;
+    bool parallel = threads > 1 &&
+        split_genome_parallel(genome_path, NUM_CHROMOSOMES, genome_store, chromosome_lengths, background, pool);
+    if (!parallel) {
+        if (threads > 1) cerr << "Upozorenje: genom se ne može obraditi paralelno, koristi se serijski prolaz" << endl;
+        split_genome(genome_path, NUM_CHROMOSOMES, genome_store, chromosome_lengths, background, fai_records, threads);
+    }
 
-        chromosome_length += chromosome.size();
-        chromosome_out_files[chr - 1] << chromosome << "\n";
+    // indeks za kasniji nasumični pristup genomu (GenomeProvider), samo za nekomprimirani genom
+    // (paralelni prolaz indeks već učitava ili sprema preko GenomeProvider)
+    if (!parallel && detect_input_format(genome_path) == InputFormat::Plain &&
+        (fai_records.empty() || !save_fai(genome_path + ".fai", fai_records)))
+        cerr << "Upozorenje: .fai indeks genoma nije spremljen" << endl;
 
-        for (const auto &l : lowercaseCoords) 
-            chromosome_out_files[chr - 1] << l.start << " " << l.end << "\n";
+    long chromosome_length = 0;
+    for (int chr = 1; chr <= NUM_CHROMOSOMES; chr++) {
+        cout << "Duzina kromosoma " << chr << ": " << chromosome_lengths[chr - 1] << endl;
+        chromosome_length += chromosome_lengths[chr - 1];
     }
 
     cout << "Broj pozitivnih CpG otoka: " << positive_cpg.size() << endl;
     cout << "Duzina originalnog kromosoma: " << chromosome_length << endl;
-    cout << "Duzina backgrounda nakon ciscenja: " << background.size() << endl;
+    cout << "Duzina backgrounda nakon ciscenja: " << background.length() << endl;
 
     for (const auto &s : positive_cpg) out1 << s << "\n";
     for (const auto &c : coords) coords_out << c.chromosome << " " << c.start << " " << c.end << "\n";
-    out2 << background;
+    if (!write_annotation_index(output_dir + "/cpg_index.bin", coords, NUM_CHROMOSOMES)) {
+        cerr << "Greška pri zapisivanju indeksa anotacija!" << endl;
+        return 1;
+    }
+    save_background_counts(out2, background);
 
 
-    for (int chr = 0; chr < NUM_CHROMOSOMES; chr++) chromosome_out_files[chr].close();
+    if (!genome_store.close()) {
+        cerr << "Greška pri zapisivanju spremnika genoma!" << endl;
+        return 1;
+    }
+    build_dinuc_caches(output_dir, NUM_CHROMOSOMES, pool);
+
+    // manifest se piše zadnji, kad postoje sve datoteke koje opisuje
+    WorkspaceManifest manifest;
+    if (!build_manifest(output_dir, NUM_CHROMOSOMES, manifest) || !save_manifest(manifest_path(output_dir), manifest)) {
+        cerr << "Greška pri zapisivanju manifesta!" << endl;
+        return 1;
+    }
     out1.close();
     out2.close();
     coords_out.close();
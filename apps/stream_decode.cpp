@@ -0,0 +1,113 @@
+#include "../algorithms/stream_decode.hpp"
+#include "../hmm/hmm_io.hpp"
+#include "../utils/structs_consts_functions.hpp"
+
+#include <cstring>
+
+
+// isti pragovi kao u decode_and_evaluation
+const double POST_ENTER = 0.60;
+const double POST_EXIT = 0.40;
+const double POST_TRIM = 0.42;
+
+
+/**
+ * @brief Čita opciju "--lag N" (dinukleotidi).
+ *
+ * @return Lag fixed-lag smoothinga (STREAM_DEFAULT_LAG ako opcija nije zadana)
+ */
+int parse_lag_option(int argc, char* argv[]) {
+    int lag = STREAM_DEFAULT_LAG;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--lag") != 0) continue;
+
+        char* end = nullptr;
+        long n = (i + 1 < argc) ? strtol(argv[i + 1], &end, 10) : 0;
+        if (end == nullptr || *end != '\0' || n < 1 || n > 100'000'000) {
+            cerr << "Neispravan lag za --lag (dinukleotidi)" << endl;
+            exit(1);
+        }
+        lag = (int)n;
+        i++;
+    }
+    return lag;
+}
+
+
+void print_islands(const string& name, StreamDecoder& decoder) {
+    vector<CpgRegion> islands = decoder.take_islands();
+    if (islands.empty()) return;
+
+    for (const auto& r : islands) {
+        cout << name << '\t' << r.start << '\t' << r.end << '\n';
+    }
+    cout.flush();
+}
+
+
+/**
+ * @brief Dekodiranje CpG otoka iz FASTA toka na standardnom ulazu.
+ *
+ * Program učitava trenirani HMM i čita FASTA (jedan ili više zapisa) sa
+ * standardnog ulaza, liniju po liniju, bez predobrade i bez učitavanja cijelog
+ * kromosoma. Kao i u predobradi, lowercase (soft-masked) baze se preskaču, a
+ * dinukleotidi se tvore od susjednih uppercase baza; dinukleotidi s bazom koja
+ * nije A/C/G/T se preskaču.
+ *
+ * Posterior se računa fixed-lag smoothingom (StreamDecoder) s lagom zadanim
+ * opcijom "--lag N" (dinukleotidi, zadano STREAM_DEFAULT_LAG), pa je memorija
+ * O(lag). Otoci se ispisuju čim su konačni, kao linije
+ * "<ime zapisa> <početak> <kraj>" (tab, 1-based originalne koordinate).
+ *
+ * Primjer: zcat chr21.fa.gz | ./stream_decode --lag 50000 > otoci.tsv
+ */
+int main(int argc, char* argv[]) {
+    const int lag = parse_lag_option(argc, argv);
+
+    HMM hmm = load_hmm("../output/trained_hmm_params.txt");
+    StreamDecoder decoder(hmm, lag, POST_ENTER, POST_EXIT, POST_TRIM);
+
+    ios::sync_with_stdio(false);
+
+    string line, name;
+    long long pos = 0;          // originalna pozicija zadnje pročitane baze
+    char prev = 0;              // zadnja uppercase baza
+    long long prev_pos = 0;
+    bool in_record = false;
+
+    while (getline(cin, line)) {
+        if (!line.empty() && line[0] == '>') {
+            if (in_record) {
+                decoder.finish();
+                print_islands(name, decoder);
+            }
+            size_t end = line.find_first_of(" \t\r", 1);
+            name = line.substr(1, end == string::npos ? string::npos : end - 1);
+            pos = 0;
+            prev = 0;
+            in_record = true;
+            continue;
+        }
+
+        for (char ch : line) {
+            if (ch == '\r' || ch == ' ') continue;
+            pos++;
+            if (ch < 'A' || ch > 'Z') continue;
+
+            if (prev) {
+                int sym = di_index(prev, ch);
+                if (sym >= 0) decoder.push((uint8_t)sym, prev_pos, pos);
+            }
+            prev = ch;
+            prev_pos = pos;
+        }
+        print_islands(name, decoder);
+    }
+
+    if (in_record) {
+        decoder.finish();
+        print_islands(name, decoder);
+    }
+
+    return 0;
+}
@@ -2,7 +2,148 @@
 #include "../hmm/hmm.hpp"
 #include "../utils/structs_consts_functions.hpp"
 #include "../train_functions/train_func.hpp"
+#include "../genome/workspace_manifest.hpp"
 #include "../algorithms/baum_welch.hpp"
+#include "../algorithms/kstep_scorer.hpp"
+
+/**
+ * @brief Čita opciju "--chunk-size N" (dinukleotidi).
+ *
+ * @return Duljina trening chunka (TRAIN_CHUNK_D ako opcija nije zadana)
+ */
+int parse_chunk_size_option(int argc, char* argv[]) {
+    int chunk_d = TRAIN_CHUNK_D;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--chunk-size") != 0) continue;
+
+        char* end = nullptr;
+        long n = (i + 1 < argc) ? strtol(argv[i + 1], &end, 10) : 0;
+        if (end == nullptr || *end != '\0' || n < 2 || n > 1'000'000'000) {
+            cerr << "Neispravna duljina chunka za --chunk-size (dinukleotidi)" << endl;
+            exit(1);
+        }
+        chunk_d = (int)n;
+        i++;
+    }
+    return chunk_d;
+}
+
+
+/**
+ * @brief Čita opciju "--chromosomes A-B" (ili "--chromosomes A").
+ *
+ * @return Raspon kromosoma {A, B} ili {0, 0} ako opcija nije zadana
+ */
+pair<int, int> parse_chromosomes_option(int argc, char* argv[]) {
+    pair<int, int> range = {0, 0};
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--chromosomes") != 0) continue;
+
+        int first = 0, last = 0;
+        char extra = 0;
+        const char* arg = (i + 1 < argc) ? argv[i + 1] : "";
+        int n = sscanf(arg, "%d-%d%c", &first, &last, &extra);
+        if (n == 1) last = first;
+        if ((n != 1 && n != 2) || first < 1 || last < first) {
+            cerr << "Neispravan raspon kromosoma za --chromosomes (npr. 1-16)" << endl;
+            exit(1);
+        }
+        range = {first, last};
+        i++;
+    }
+    return range;
+}
+
+
+/**
+ * Trening podaci jednog kromosoma: opažanja (mapirana cache datoteka
+ * predobrade) te trening sekvence i maske kao pogledi u njih.
+ */
+struct TrainingChromosome {
+    int chromosome = 0;
+    DinucCache dinucs;
+    vector<ObsView> sequences;
+    vector<uint8_t> mask_all;
+    vector<MaskView> masks;
+};
+
+
+/**
+ * @brief Učitava kromosom iz otvorenog spremnika genoma i gradi trening
+ * sekvence s maskama dozvoljenih stanja.
+ */
+void load_training_chromosome(GenomeStore& store, int chr, int chunk_d, TrainingChromosome& tc) {
+    if (store.entry(chr) == nullptr) {
+        cerr << "Kromosom " << chr << " ne postoji u spremniku ../output/genome_store.bin" << endl;
+        exit(1);
+    }
+    PackedSequence s = store.sequence(chr);
+    vector<lowerCaseRegions> lc = store.lowercase_regions(chr);
+
+    cout << "Učitana sekvenca za kromosom " << chr << " dužine " << s.size() << endl;
+    check_workspace("../output", store, chr);
+
+    vector<CpgRegion> coords_chr_orig = load_all_or_selected_coords("../output", chr);
+    vector<CpgRegion> coords_chr_comp = map_orig_coords_to_compressed(s, CoordinateMap(lc), coords_chr_orig);
+
+    // opažanja se mapiraju iz cache datoteke predobrade umjesto ponovnog kodiranja
+    tc.chromosome = chr;
+    load_or_build_dinuc_cache("../output", store, chr, tc.dinucs);
+
+    // ------- SEMI-SUPERVIZIJA: maska dozvoljenih stanja -------
+    build_masked_sequences(s, tc.dinucs.observations(), coords_chr_comp, tc.sequences, tc.mask_all, tc.masks, chunk_d);
+
+    cout << "Izgrađene " << tc.sequences.size() << " trening sekvence sa maskama.\n";
+}
+
+
+/**
+ * @brief Log-vjerojatnost trening sekvenci s maskama (KStepScorer). Kao i u
+ * E-koraku, preskaču se sekvence kraće od 2, pa je zbroj usporediv s logL iteracija.
+ */
+double masked_loglik(const KStepScorer& scorer, const vector<ObsView>& sequences, const vector<MaskView>& masks) {
+    double ll = 0.0;
+    for (size_t k = 0; k < sequences.size(); k++) {
+        if (sequences[k].size() < 2) continue;
+        double l = scorer.loglik_masked(sequences[k], masks[k]);
+        if (isfinite(l)) ll += l;
+    }
+    return ll;
+}
+
+
+/**
+ * @brief Baum-Welch do konvergencije (ili 10 iteracija) nad svim zadanim
+ * trening sekvencama; ispisuje logL po iteraciji i završni logL.
+ */
+void train_on_sequences(
+    const vector<ObsView>& sequences,
+    const vector<MaskView>& masks,
+    HMM& hmm,
+    ThreadPool* scan_pool,
+    ThreadPool* pool,
+    bool forward_only
+) {
+    // bez trening sekvenci E-korak ne daje brojeve i parametri bi se spremili nepromijenjeni
+    if (sequences.empty()) {
+        cerr << "Nema trening sekvenci (provjeriti cache opažanja i --chunk-size)" << endl;
+        exit(1);
+    }
+
+    double prev_ll = -1e100;
+    for (int iter = 0; iter < 10; iter++) {
+        double ll = 0.0;
+        baum_welch_iteration_multi_masked(sequences, masks, hmm, ll, scan_pool, pool, forward_only);
+        
+        cout << "Iter " << iter << " logL = " << ll << endl;
+
+        if (fabs(ll - prev_ll) < 1e-3) break;
+        prev_ll = ll;
+    }
+
+    cout << "Završni logL = " << masked_loglik(KStepScorer(hmm), sequences, masks) << endl;
+}
+
 
 /**
  * @brief Treniranje skrivenog Markovljevog modela (HMM) za CpG detekciju
@@ -24,45 +165,135 @@
  * Rezultat je ažurirani skup HMM parametara koji se spremaju na disk
  * i koriste za kasnije dekodiranje CpG otoka.
  *
+ * Opcija "--scan-threads N" (N > 1) računa E-korak paralelnim scanom po
+ * vremenu (expected_counts_parallel) na N dretvi. Opcija "--threads N" (N > 1)
+ * raspoređuje trening sekvence E-koraka na N dretvi; parametri i logL su
+ * bitovno isti za bilo koji N. Opcija "--forward-only" računa E-korak samo
+ * forward prolazom (memorija ne ovisi o duljini trening sekvenci), a
+ * "--chunk-size N" mijenja duljinu trening sekvenci (zadano TRAIN_CHUNK_D
+ * dinukleotida; chunkovi se režu na N-regijama).
+ *
+ * Opcija "--chromosomes A-B" trenira na rasponu kromosoma u jednom procesu,
+ * počevši od inicijalnih parametara: spremnik genoma otvara se jednom, a
+ * opažanja svih kromosoma su mapirane cache datoteke. Zadano se svi chunkovi
+ * svih kromosoma učitaju odjednom i trenira se zajednički EM (maske zauzimaju
+ * jedan bajt po dinukleotidu). Uz "--sequential" kromosomi se treniraju redom,
+ * jedan po jedan, s istim rezultatom kao zasebna pokretanja programa po
+ * kromosomu (parametri se spremaju i ponovno učitavaju nakon svakog kromosoma).
+ * Uz "--score-only" ispisuje se log-vjerojatnost trening sekvenci svakog
+ * kromosoma i ukupno za trenutne parametre.
+ *
+ * Nakon treniranja ispisuje se log-vjerojatnost trening sekvenci za spremljene
+ * parametre (KStepScorer, bez E-koraka). Opcija "--score-only" samo računa
+ * log-vjerojatnost trening sekvenci (s maskama) i cijelog kromosoma (bez maske)
+ * za učitane parametre, bez treniranja i spremanja.
+ *
  * @note Trening koristi komprimiranu sekvencu bez lowercase regija.
  * @note Koordinate referentnih CpG otoka mapiraju se na komprimirani prostor.
  */
-int main() {
+int main(int argc, char* argv[]) {
+    const int scan_threads = parse_threads_option(argc, argv, 1, "--scan-threads");
+    bool score_only = false;
+    bool forward_only = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--score-only") == 0) score_only = true;
+        if (strcmp(argv[i], "--forward-only") == 0) forward_only = true;
+    }
+    const int chunk_d = parse_chunk_size_option(argc, argv);
+    const int threads = parse_threads_option(argc, argv, 1, "--threads");
+    unique_ptr<ThreadPool> scan_pool;
+    if (scan_threads > 1) scan_pool.reset(new ThreadPool(scan_threads));
+    unique_ptr<ThreadPool> pool;
+    if (threads > 1) pool.reset(new ThreadPool(threads));
+
+    const pair<int, int> range = parse_chromosomes_option(argc, argv);
+    bool sequential = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--sequential") == 0) sequential = true;
+    }
+
     HMM hmm;
+    GenomeStore store;
+
+    // ------- više kromosoma u jednom procesu -------
+    if (range.first > 0) {
+        open_genome_store_or_exit("../output/genome_store.bin", store, range.first);
 
+        if (score_only) {
+            // trenutni parametri, bez treniranja i spremanja
+            hmm = ifstream("../output/trained_hmm_params.txt") ? load_hmm("../output/trained_hmm_params.txt")
+                                                               : load_hmm("../output/init_hmm_params.txt");
+            KStepScorer scorer(hmm);
+            double total = 0.0;
+            for (int chr = range.first; chr <= range.second; chr++) {
+                TrainingChromosome tc;
+                load_training_chromosome(store, chr, chunk_d, tc);
+                double ll = masked_loglik(scorer, tc.sequences, tc.masks);
+                cout << "logL trening sekvenci = " << ll << endl;
+                total += ll;
+            }
+            cout << "logL trening sekvenci (kromosomi " << range.first << "-" << range.second << ") = " << total << endl;
+            return 0;
+        }
+
+        hmm = load_hmm("../output/init_hmm_params.txt");
+
+        if (sequential) {
+            // redom po kromosomima, kao zasebna pokretanja programa
+            for (int chr = range.first; chr <= range.second; chr++) {
+                cout << "\n--- Treniranje na kromosomu " << chr << " ---\n";
+                TrainingChromosome tc;
+                load_training_chromosome(store, chr, chunk_d, tc);
+                train_on_sequences(tc.sequences, tc.masks, hmm, scan_pool.get(), pool.get(), forward_only);
+
+                hmm.chromosome = chr;
+                save_hmm(hmm, "../output/trained_hmm_params.txt");
+                hmm = load_hmm("../output/trained_hmm_params.txt");
+            }
+            return 0;
+        }
+
+        // zajednički EM nad svim chunkovima svih kromosoma
+        vector<unique_ptr<TrainingChromosome>> chromosomes;
+        vector<ObsView> sequences;
+        vector<MaskView> masks;
+        for (int chr = range.first; chr <= range.second; chr++) {
+            chromosomes.emplace_back(new TrainingChromosome());
+            TrainingChromosome& tc = *chromosomes.back();
+            load_training_chromosome(store, chr, chunk_d, tc);
+            sequences.insert(sequences.end(), tc.sequences.begin(), tc.sequences.end());
+            masks.insert(masks.end(), tc.masks.begin(), tc.masks.end());
+        }
+        cout << "Ukupno " << sequences.size() << " trening sekvenci iz kromosoma "
+             << range.first << "-" << range.second << ".\n";
+
+        train_on_sequences(sequences, masks, hmm, scan_pool.get(), pool.get(), forward_only);
+
+        hmm.chromosome = range.second;
+        save_hmm(hmm, "../output/trained_hmm_params.txt");
+        return 0;
+    }
+
+    // ------- jedan kromosom (iz spremljenih parametara) -------
     if (ifstream("../output/trained_hmm_params.txt")) {
         hmm = load_hmm("../output/trained_hmm_params.txt");
     } else {
         hmm = load_hmm("../output/init_hmm_params.txt");
     }
 
-    string s;
-    vector<lowerCaseRegions> lc;
-    get_chromosome_and_lowercase_regions("../output/" + to_string(hmm.chromosome) + "_train_chr.txt", s, lc);
-    
-    cout << "Učitana sekvenca za kromosom " << hmm.chromosome << " dužine " << s.size() << endl;
+    open_genome_store_or_exit("../output/genome_store.bin", store, hmm.chromosome);
+    TrainingChromosome tc;
+    load_training_chromosome(store, hmm.chromosome, chunk_d, tc);
 
-    vector<CpgRegion> coords_chr_orig = load_all_or_selected_coords(hmm.chromosome);
-    vector<CpgRegion> coords_chr_comp = map_orig_coords_to_compressed(s, lc, coords_chr_orig);
-
-    // ------- SEMI-SUPERVIZIJA: maska dozvoljenih stanja -------
-    vector<vector<int>> sequences;
-    vector<vector<array<double, NSTATE>>> masks;
-    build_masked_sequences(s, coords_chr_comp, sequences, masks);
-    
-    cout << "Izgrađene " << sequences.size() << " trening sekvence sa maskama.\n";
+    if (score_only) {
+        KStepScorer scorer(hmm);
+        cout << "logL trening sekvenci = " << masked_loglik(scorer, tc.sequences, tc.masks) << endl;
+        cout << "logL kromosoma (bez maske) = " << scorer.loglik(tc.dinucs.observations()) << endl;
+        return 0;
+    }
 
     // ------- Baum-Welch na mini-sekvencama -------
-    double prev_ll = -1e100;
-    for (int iter = 0; iter < 10; iter++) {
-        double ll = 0.0;
-        baum_welch_iteration_multi_masked(sequences, masks, hmm, ll);
-        
-        cout << "Iter " << iter << " logL = " << ll << endl;
-
-        if (fabs(ll - prev_ll) < 1e-3) break;
-        prev_ll = ll;
-    }
+    train_on_sequences(tc.sequences, tc.masks, hmm, scan_pool.get(), pool.get(), forward_only);
 
     save_hmm(hmm, "../output/trained_hmm_params.txt");
 
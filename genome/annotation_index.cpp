@@ -0,0 +1,94 @@
+#include "./annotation_index.hpp"
+
+#include <cstring>
+
+
+bool write_annotation_index(const string& path, const vector<CpgRegion>& coords, int num_chromosomes) {
+    vector<CpgRegion> sorted;
+    sorted.reserve(coords.size());
+    for (const auto& r : coords) {
+        if (r.chromosome >= 1) sorted.push_back(r);
+    }
+    stable_sort(sorted.begin(), sorted.end(), [](const CpgRegion& a, const CpgRegion& b) {
+        return a.chromosome != b.chromosome ? a.chromosome < b.chromosome : a.start < b.start;
+    });
+
+    int max_chr = num_chromosomes;
+    if (!sorted.empty()) max_chr = max(max_chr, sorted.back().chromosome);
+
+    vector<AnnotationIndexEntry> entries(max_chr, AnnotationIndexEntry{0, 0});
+    for (size_t i = 0; i < sorted.size(); i++) {
+        AnnotationIndexEntry& e = entries[sorted[i].chromosome - 1];
+        if (e.count == 0) e.offset = i;
+        e.count++;
+    }
+    // kromosomi bez otoka pokazuju na mjesto gdje bi bili, radi monotonih offseta
+    for (int k = 0; k < max_chr; k++) {
+        if (entries[k].count == 0) entries[k].offset = (k == 0) ? 0 : entries[k - 1].offset + entries[k - 1].count;
+    }
+
+    Checksum64 c;
+    c.update(entries.data(), entries.size() * sizeof(AnnotationIndexEntry));
+    c.update(sorted.data(), sorted.size() * sizeof(CpgRegion));
+
+    AnnotationIndexHeader header;
+    memcpy(header.magic, ANNOTATION_INDEX_MAGIC, sizeof(header.magic));
+    header.version = ANNOTATION_INDEX_VERSION;
+    header.num_chromosomes = (uint32_t)max_chr;
+    header.count = sorted.size();
+    header.checksum = c.value();
+
+    ofstream out(path, ios::binary | ios::trunc);
+    if (!out) return false;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(AnnotationIndexEntry));
+    out.write(reinterpret_cast<const char*>(sorted.data()), sorted.size() * sizeof(CpgRegion));
+    out.close();
+    return !out.fail();
+}
+
+
+bool AnnotationIndex::open(const string& path) {
+    entries = nullptr;
+    records = nullptr;
+    if (!file.open(path) || file.size() < sizeof(AnnotationIndexHeader)) return false;
+
+    memcpy(&header, file.data(), sizeof(header));
+    if (memcmp(header.magic, ANNOTATION_INDEX_MAGIC, sizeof(header.magic)) != 0) return false;
+    if (header.version != ANNOTATION_INDEX_VERSION) return false;
+
+    size_t table_bytes = header.num_chromosomes * sizeof(AnnotationIndexEntry);
+    size_t record_bytes = header.count * sizeof(CpgRegion);
+    if (file.size() != sizeof(AnnotationIndexHeader) + table_bytes + record_bytes) return false;
+
+    const char* table = file.data() + sizeof(AnnotationIndexHeader);
+    Checksum64 c;
+    c.update(table, table_bytes + record_bytes);
+    if (c.value() != header.checksum) return false;
+
+    entries = reinterpret_cast<const AnnotationIndexEntry*>(table);
+    records = reinterpret_cast<const CpgRegion*>(table + table_bytes);
+    for (uint32_t k = 0; k < header.num_chromosomes; k++) {
+        if (entries[k].offset + entries[k].count > header.count) return false;
+    }
+    return true;
+}
+
+
+const AnnotationIndexEntry* AnnotationIndex::entry(int chr) const {
+    if (entries == nullptr || chr < 1 || chr > (int)header.num_chromosomes) return nullptr;
+    return &entries[chr - 1];
+}
+
+
+vector<CpgRegion> AnnotationIndex::regions(int chr) const {
+    const AnnotationIndexEntry* e = entry(chr);
+    if (e == nullptr) return {};
+    return vector<CpgRegion>(records + e->offset, records + e->offset + e->count);
+}
+
+
+vector<CpgRegion> AnnotationIndex::all() const {
+    if (records == nullptr) return {};
+    return vector<CpgRegion>(records, records + header.count);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "../utils/structs_consts_functions.hpp"
+#include "../utils/checksum.hpp"
+#include "./mapped_file.hpp"
+
+using namespace std;
+
+
+/**
+ * Binarni indeks CpG anotacija (cpg_index.bin), zamjena za parsiranje coords.txt.
+ *
+ * Otoci su sortirani po (kromosom, start), a tablica na početku daje za svaki
+ * kromosom offset i broj njegovih otoka, pa se otoci jednog kromosoma dohvaćaju
+ * izravno, bez čitanja ostatka datoteke.
+ *
+ * Raspored datoteke:
+ *  - AnnotationIndexHeader
+ *  - AnnotationIndexEntry[num_chromosomes]   (kromosom k je na mjestu k - 1)
+ *  - CpgRegion[count]
+ */
+constexpr char ANNOTATION_INDEX_MAGIC[8] = {'C', 'P', 'G', 'A', 'N', 'N', 'O', 'T'};
+constexpr uint32_t ANNOTATION_INDEX_VERSION = 1;
+
+struct AnnotationIndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_chromosomes;
+    uint64_t count;       // ukupan broj otoka
+    uint64_t checksum;    // Checksum64 tablice i otoka
+};
+
+struct AnnotationIndexEntry {
+    uint64_t offset;      // indeks prvog otoka kromosoma
+    uint64_t count;
+};
+
+static_assert(sizeof(AnnotationIndexHeader) == 32, "neočekivan raspored AnnotationIndexHeader");
+static_assert(sizeof(AnnotationIndexEntry) == 16, "neočekivan raspored AnnotationIndexEntry");
+static_assert(sizeof(CpgRegion) == 12, "CpgRegion se sprema izravno u indeks");
+
+
+/**
+ * @brief Sortira otoke (stabilno, po kromosomu pa početku) i zapisuje indeks.
+ * Otoci s kromosomom izvan [1, num_chromosomes] proširuju tablicu do najvećeg kromosoma.
+ *
+ * @return false ako se datoteka ne može zapisati
+ */
+bool write_annotation_index(const string& path, const vector<CpgRegion>& coords, int num_chromosomes);
+
+
+/**
+ * @brief Mapirani indeks CpG anotacija.
+ */
+class AnnotationIndex {
+public:
+    /**
+     * @return false ako datoteka ne postoji, oštećena je ili nije ispravnog formata
+     */
+    bool open(const string& path);
+
+    /**
+     * @brief Otoci jednog kromosoma, sortirani po početku (prazno ako ih nema).
+     */
+    vector<CpgRegion> regions(int chr) const;
+
+    /**
+     * @brief Svi otoci, sortirani po kromosomu pa početku.
+     */
+    vector<CpgRegion> all() const;
+
+    const AnnotationIndexEntry* entry(int chr) const;
+
+    uint64_t count() const { return header.count; }
+    uint64_t checksum() const { return header.checksum; }
+
+private:
+    MappedFile file;
+    AnnotationIndexHeader header = {};
+    const AnnotationIndexEntry* entries = nullptr;
+    const CpgRegion* records = nullptr;
+};
@@ -0,0 +1,280 @@
+#include "./compressed_input.hpp"
+
+#include <cstring>
+#include <stdexcept>
+#include <cstdint>
+#include <zlib.h>
+
+
+namespace {
+
+constexpr size_t GZIP_CHUNK = 1 << 18;        // 256 KB ulaza/izlaza za slijedni gzip
+constexpr size_t BGZF_BATCH_BYTES = 1 << 20;  // ~1 MB komprimiranih blokova po zadatku
+
+
+/**
+ * istream koji posjeduje svoj streambuf.
+ */
+class OwningIstream : public istream {
+public:
+    explicit OwningIstream(unique_ptr<streambuf> b) : istream(b.get()), buf(std::move(b)) {}
+
+private:
+    unique_ptr<streambuf> buf;
+};
+
+
+uint16_t read_le16(const unsigned char* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+uint32_t read_le32(const unsigned char* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+
+/**
+ * @brief Iz gzip headera (barem 12 bajtova + extra polje) čita BSIZE ako je BGZF blok.
+ * @return ukupna veličina bloka ili 0 ako header nije BGZF
+ */
+size_t bgzf_block_size(const unsigned char* header, size_t available) {
+    if (available < 12) return 0;
+    if (header[0] != 0x1f || header[1] != 0x8b || header[2] != 8 || !(header[3] & 4)) return 0;
+
+    size_t xlen = read_le16(header + 10);
+    if (available < 12 + xlen) return 0;
+
+    const unsigned char* extra = header + 12;
+    size_t pos = 0;
+    while (pos + 4 <= xlen) {
+        size_t slen = read_le16(extra + pos + 2);
+        if (extra[pos] == 'B' && extra[pos + 1] == 'C' && slen == 2 && pos + 6 <= xlen) {
+            return (size_t)read_le16(extra + pos + 4) + 1;
+        }
+        pos += 4 + slen;
+    }
+    return 0;
+}
+
+
+/**
+ * @brief Dekomprimira seriju uzastopnih BGZF blokova.
+ */
+string inflate_bgzf_batch(const string& raw) {
+    string out;
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(raw.data());
+    size_t pos = 0;
+
+    while (pos < raw.size()) {
+        size_t block = bgzf_block_size(data + pos, raw.size() - pos);
+        size_t xlen = read_le16(data + pos + 10);
+        size_t cdata = block - 12 - xlen - 8;
+        uint32_t crc = read_le32(data + pos + block - 8);
+        uint32_t isize = read_le32(data + pos + block - 4);
+
+        size_t old = out.size();
+        out.resize(old + isize);
+
+        if (isize > 0) {
+            z_stream zs;
+            memset(&zs, 0, sizeof(zs));
+            if (inflateInit2(&zs, -MAX_WBITS) != Z_OK) throw runtime_error("inflateInit2 nije uspio");
+            zs.next_in = const_cast<Bytef*>(data + pos + 12 + xlen);
+            zs.avail_in = (uInt)cdata;
+            zs.next_out = reinterpret_cast<Bytef*>(&out[old]);
+            zs.avail_out = isize;
+            int ret = inflate(&zs, Z_FINISH);
+            inflateEnd(&zs);
+
+            if (ret != Z_STREAM_END || zs.avail_out != 0 ||
+                crc32(0L, reinterpret_cast<const Bytef*>(&out[old]), isize) != crc) {
+                throw runtime_error("oštećen BGZF blok");
+            }
+        }
+        pos += block;
+    }
+    return out;
+}
+
+}  // namespace
+
+
+InputFormat detect_input_format(const string& path) {
+    ifstream in(path, ios::binary);
+    unsigned char header[64] = {0};
+    in.read(reinterpret_cast<char*>(header), sizeof(header));
+    size_t n = (size_t)in.gcount();
+
+    if (n < 2 || header[0] != 0x1f || header[1] != 0x8b) return InputFormat::Plain;
+    return bgzf_block_size(header, n) > 0 ? InputFormat::Bgzf : InputFormat::Gzip;
+}
+
+
+string resolve_input_path(const string& path) {
+    if (ifstream(path)) return path;
+    if (ifstream(path + ".gz")) return path + ".gz";
+    return path;
+}
+
+
+GzipStreambuf::GzipStreambuf(const string& path)
+    : file(path, ios::binary), in_buf(GZIP_CHUNK), out_buf(GZIP_CHUNK) {
+    if (!file) return;
+
+    z_stream* s = new z_stream;
+    memset(s, 0, sizeof(*s));
+    if (inflateInit2(s, 16 + MAX_WBITS) != Z_OK) {
+        delete s;
+        return;
+    }
+    zs = s;
+    opened = true;
+}
+
+
+GzipStreambuf::~GzipStreambuf() {
+    if (zs != nullptr) {
+        inflateEnd(static_cast<z_stream*>(zs));
+        delete static_cast<z_stream*>(zs);
+    }
+}
+
+
+GzipStreambuf::int_type GzipStreambuf::underflow() {
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+    if (!opened || finished) return traits_type::eof();
+
+    z_stream* s = static_cast<z_stream*>(zs);
+
+    for (;;) {
+        if (s->avail_in == 0) {
+            file.read(in_buf.data(), in_buf.size());
+            s->next_in = reinterpret_cast<Bytef*>(in_buf.data());
+            s->avail_in = (uInt)file.gcount();
+            if (s->avail_in == 0) {
+                // kraj datoteke usred gzip člana: datoteka je skraćena
+                if (member_open) {
+                    cerr << "Gzip datoteka je skraćena (nedostaje kraj gzip člana)" << endl;
+                    exit(1);
+                }
+                finished = true;
+                return traits_type::eof();
+            }
+        }
+
+        s->next_out = reinterpret_cast<Bytef*>(out_buf.data());
+        s->avail_out = (uInt)out_buf.size();
+        member_open = true;
+        int ret = inflate(s, Z_NO_FLUSH);
+
+        if (ret == Z_STREAM_END) {
+            // sljedeći gzip član (ako postoji) počinje odmah iza ovoga
+            inflateReset(s);
+            member_open = false;
+        } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            cerr << "Greška pri dekompresiji gzip datoteke (oštećeni podaci)" << endl;
+            exit(1);
+        }
+
+        size_t produced = out_buf.size() - s->avail_out;
+        if (produced > 0) {
+            setg(out_buf.data(), out_buf.data(), out_buf.data() + produced);
+            return traits_type::to_int_type(*gptr());
+        }
+    }
+}
+
+
+BgzfStreambuf::BgzfStreambuf(const string& path, int threads)
+    : file(path, ios::binary) {
+    if (!file) return;
+
+    // s jednom dretvom serije se dekomprimiraju odmah, na dretvi čitatelja
+    if (threads != 1) pool = make_unique<ThreadPool>(threads);
+    max_pending = pool ? 2 * (size_t)pool->size() + 2 : 1;
+    opened = true;
+}
+
+
+bool BgzfStreambuf::schedule_batch() {
+    if (eof) return false;
+
+    string raw;
+    unsigned char header[18 + 256];
+
+    while (raw.size() < BGZF_BATCH_BYTES) {
+        file.read(reinterpret_cast<char*>(header), 12);
+        if (file.gcount() == 0) {
+            // ispravan BGZF završava praznim EOF blokom; bez njega je datoteka skraćena
+            if (!last_block_empty) throw runtime_error("nedostaje završni EOF blok (skraćena datoteka)");
+            eof = true;
+            break;
+        }
+        if (file.gcount() < 12) throw runtime_error("nepotpun BGZF blok");
+
+        size_t xlen = read_le16(header + 10);
+        if (xlen > sizeof(header) - 12) throw runtime_error("neispravan BGZF header");
+        file.read(reinterpret_cast<char*>(header + 12), xlen);
+
+        size_t block = bgzf_block_size(header, 12 + (size_t)file.gcount());
+        if (block == 0 || block < 12 + xlen + 8) throw runtime_error("datoteka nije ispravan BGZF");
+
+        size_t old = raw.size();
+        raw.resize(old + block);
+        memcpy(&raw[old], header, 12 + xlen);
+        file.read(&raw[old + 12 + xlen], block - 12 - xlen);
+        if ((size_t)file.gcount() != block - 12 - xlen) throw runtime_error("nepotpun BGZF blok");
+        last_block_empty = read_le32(reinterpret_cast<const unsigned char*>(&raw[old + block - 4])) == 0;
+    }
+
+    if (raw.empty()) return false;
+    if (pool) {
+        pending.push_back(pool->submit([batch = move(raw)] { return inflate_bgzf_batch(batch); }));
+    } else {
+        promise<string> done;
+        done.set_value(inflate_bgzf_batch(raw));
+        pending.push_back(done.get_future());
+    }
+    return true;
+}
+
+
+BgzfStreambuf::int_type BgzfStreambuf::underflow() {
+    if (gptr() < egptr()) return traits_type::to_int_type(*gptr());
+    if (!opened) return traits_type::eof();
+
+    try {
+        for (;;) {
+            while (pending.size() < max_pending && schedule_batch()) {}
+            if (pending.empty()) return traits_type::eof();
+
+            current = pending.front().get();
+            pending.pop_front();
+            if (!current.empty()) break;
+        }
+    } catch (const exception& e) {
+        // već dekomprimirani blokovi se ne predaju: oštećena datoteka prekida program
+        cerr << "Greška pri dekompresiji BGZF datoteke: " << e.what() << endl;
+        exit(1);
+    }
+
+    setg(&current[0], &current[0], &current[0] + current.size());
+    return traits_type::to_int_type(*gptr());
+}
+
+
+unique_ptr<istream> open_input_stream(const string& path, int threads) {
+    if (!ifstream(path)) return nullptr;
+
+    switch (detect_input_format(path)) {
+        case InputFormat::Bgzf: {
+            auto buf = make_unique<BgzfStreambuf>(path, threads);
+            if (!buf->is_open()) return nullptr;
+            return make_unique<OwningIstream>(move(buf));
+        }
+        case InputFormat::Gzip: {
+            auto buf = make_unique<GzipStreambuf>(path);
+            if (!buf->is_open()) return nullptr;
+            return make_unique<OwningIstream>(move(buf));
+        }
+        default:
+            return make_unique<ifstream>(path);
+    }
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <future>
+#include <memory>
+
+#include "../utils/thread_pool.hpp"
+
+using namespace std;
+
+
+/**
+ * Čitanje ulaznih datoteka (FASTA genoma, pozitivni CpG otoci) koje mogu biti
+ * nekomprimirane, gzip ili BGZF (blokovski gzip, npr. iz bgzip/samtools).
+ *
+ * Format se prepoznaje po sadržaju, ne po ekstenziji. Svi formati se čitaju kroz
+ * std::istream pa postojeći kod s getline() ostaje isti.
+ */
+
+
+/**
+ * @brief Vrsta ulazne datoteke.
+ */
+enum class InputFormat { Plain, Gzip, Bgzf };
+
+
+/**
+ * @brief Prepoznaje format datoteke prema prvom gzip headeru.
+ */
+InputFormat detect_input_format(const string& path);
+
+
+/**
+ * @brief Vraća path ako datoteka postoji, inače path + ".gz" ako ta postoji.
+ * Ako ne postoji nijedna, vraća path (greška se javlja pri otvaranju).
+ */
+string resolve_input_path(const string& path);
+
+
+/**
+ * @brief streambuf koji slijedno dekomprimira gzip datoteku (podržava i više
+ * spojenih gzip članova, npr. nastalih s cat a.gz b.gz). Ako datoteka završi
+ * usred gzip člana (skraćena datoteka) ili su podaci oštećeni, ispisuje grešku
+ * i prekida program.
+ */
+class GzipStreambuf : public streambuf {
+public:
+    explicit GzipStreambuf(const string& path);
+    ~GzipStreambuf() override;
+
+    bool is_open() const { return opened; }
+
+protected:
+    int_type underflow() override;
+
+private:
+    ifstream file;
+    void* zs = nullptr;   // z_stream, skriven da header ne ovisi o zlib.h
+    vector<char> in_buf;
+    vector<char> out_buf;
+    bool opened = false;
+    bool finished = false;
+    bool member_open = false;   // gzip član je započet, a Z_STREAM_END još nije stigao
+};
+
+
+/**
+ * @brief streambuf za BGZF datoteke. Komprimirani blokovi se čitaju slijedno,
+ * grupiraju u serije i dekomprimiraju paralelno na bazenu dretvi; rezultati
+ * se predaju čitatelju redom kojim su blokovi u datoteci. Oštećen ili nepotpun
+ * blok te datoteka bez završnog praznog EOF bloka prekidaju program s greškom.
+ */
+class BgzfStreambuf : public streambuf {
+public:
+    /**
+     * @param path Putanja do BGZF datoteke
+     * @param threads Broj dretvi za dekompresiju (0 = broj jezgri, 1 = bez bazena
+     *        dretvi, dekompresija na dretvi čitatelja)
+     */
+    BgzfStreambuf(const string& path, int threads);
+
+    bool is_open() const { return opened; }
+
+protected:
+    int_type underflow() override;
+
+private:
+    /**
+     * @brief Čita sljedeću seriju komprimiranih blokova i šalje je na dekompresiju.
+     * @return false ako nema više blokova
+     */
+    bool schedule_batch();
+
+    ifstream file;
+    unique_ptr<ThreadPool> pool;
+    deque<future<string>> pending;
+    string current;
+    size_t max_pending;
+    bool opened = false;
+    bool eof = false;
+    bool last_block_empty = false;   // zadnji pročitani blok je prazan (BGZF EOF blok)
+};
+
+
+/**
+ * @brief Otvara ulaznu datoteku bilo kojeg podržanog formata.
+ *
+ * @param path Putanja do datoteke
+ * @param threads Broj dretvi za BGZF dekompresiju (0 = broj jezgri, 1 = serijski)
+ *
+ * @return istream ili nullptr ako se datoteka ne može otvoriti
+ */
+unique_ptr<istream> open_input_stream(const string& path, int threads = 0);
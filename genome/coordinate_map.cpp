@@ -0,0 +1,86 @@
+#include "./coordinate_map.hpp"
+
+
+CoordinateMap::CoordinateMap(const vector<lowerCaseRegions>& lowercase) {
+    starts.reserve(lowercase.size());
+    ends.reserve(lowercase.size());
+    prefix.reserve(lowercase.size());
+    comp_start.reserve(lowercase.size());
+
+    long long removed = 0;
+    for (const auto& r : lowercase) {
+        starts.push_back(r.start);
+        ends.push_back(r.end);
+        prefix.push_back(removed);
+        comp_start.push_back(r.start - removed);
+        removed += r.end - r.start + 1;
+    }
+}
+
+
+size_t CoordinateMap::count_not_greater(const vector<long long>& keys, long long key, size_t hint) {
+    const size_t n = keys.size();
+    hint = min(hint, n);
+    size_t lo, hi;
+
+    if (hint < n && keys[hint] <= key) {
+        // odgovor je iza hint: koraci 1, 2, 4, ... dok ne prijeđemo key
+        size_t step = 1;
+        lo = hint + 1;
+        hi = lo;
+        while (hi < n && keys[hi] <= key) {
+            lo = hi + 1;
+            hi = min(n, hi + step);
+            step <<= 1;
+        }
+    } else {
+        // odgovor je na ili ispred hint
+        size_t step = 1;
+        hi = hint;
+        lo = hi;
+        while (lo > 0 && keys[lo - 1] > key) {
+            hi = lo - 1;
+            lo = (lo > step) ? lo - step : 0;
+            step <<= 1;
+        }
+    }
+
+    return (size_t)(upper_bound(keys.begin() + lo, keys.begin() + hi, key) - keys.begin());
+}
+
+
+long long CoordinateMap::removed_before(size_t k, long long orig_pos) const {
+    // k intervala počinje prije orig_pos; samo zadnji od njih može biti djelomično ispred
+    if (k == 0) return 0;
+    return prefix[k - 1] + min(ends[k - 1], orig_pos - 1) - starts[k - 1] + 1;
+}
+
+
+long long CoordinateMap::to_compressed(long long orig_pos) const {
+    size_t k = (size_t)(upper_bound(starts.begin(), starts.end(), orig_pos - 1) - starts.begin());
+    return orig_pos - removed_before(k, orig_pos);
+}
+
+
+long long CoordinateMap::to_original(long long comp_pos) const {
+    size_t k = (size_t)(upper_bound(comp_start.begin(), comp_start.end(), comp_pos) - comp_start.begin());
+    return (k == 0) ? comp_pos : comp_pos + prefix[k - 1] + (ends[k - 1] - starts[k - 1] + 1);
+}
+
+
+void CoordinateMap::to_compressed(vector<long long>& positions) const {
+    size_t k = 0;
+    for (auto& p : positions) {
+        k = count_not_greater(starts, p - 1, k);
+        p -= removed_before(k, p);
+    }
+}
+
+
+void CoordinateMap::to_original(vector<long long>& positions) const {
+    size_t k = 0;
+    for (auto& p : positions) {
+        k = count_not_greater(comp_start, p, k);
+        if (k > 0) p += prefix[k - 1] + (ends[k - 1] - starts[k - 1] + 1);
+    }
+}
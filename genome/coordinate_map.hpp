@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include "../utils/structs_consts_functions.hpp"
+
+using namespace std;
+
+
+/**
+ * Dvosmjerno preslikavanje između originalnih koordinata kromosoma i koordinata
+ * komprimirane sekvence (bez lowercase regija), obje 1-based.
+ *
+ * Gradi se jednom po kromosomu iz sortiranih, disjunktnih lowercase intervala:
+ * za svaki interval pamti se broj lowercase baza ispred njega (prefiksna suma) i
+ * komprimirana pozicija na kojoj bi se nalazio. Pojedinačni upit je binarno
+ * pretraživanje, O(log n).
+ *
+ * Skupni upiti (vektor pozicija) pretragu započinju od rezultata prethodne pozicije
+ * (galopirajuće pretraživanje), pa je prolaz kroz sortirane pozicije O(m log(n / m) + m);
+ * nesortirani ulaz je i dalje ispravan.
+ */
+class CoordinateMap {
+public:
+    CoordinateMap() = default;
+
+    /**
+     * @param lowercase Lowercase intervali kromosoma (1-based, originalne koordinate, sortirani)
+     */
+    explicit CoordinateMap(const vector<lowerCaseRegions>& lowercase);
+
+    /**
+     * @brief Originalna pozicija -> komprimirana: oduzima broj lowercase baza ispred
+     * pozicije. Pozicija unutar lowercase regije preslikava se na prvu sljedeću
+     * uppercase bazu.
+     */
+    long long to_compressed(long long orig_pos) const;
+
+    /**
+     * @brief Komprimirana pozicija -> originalna: dodaje duljine svih lowercase regija
+     * koje prethode bazi.
+     */
+    long long to_original(long long comp_pos) const;
+
+    /**
+     * @brief Skupno preslikavanje originalnih pozicija u komprimirane (na mjestu).
+     */
+    void to_compressed(vector<long long>& positions) const;
+
+    /**
+     * @brief Skupno preslikavanje komprimiranih pozicija u originalne (na mjestu).
+     */
+    void to_original(vector<long long>& positions) const;
+
+    size_t size() const { return starts.size(); }
+
+private:
+    /**
+     * @brief Broj elemenata keys manjih ili jednakih key, počevši pretragu od hint
+     * (galopiranje prema naprijed ili natrag).
+     */
+    static size_t count_not_greater(const vector<long long>& keys, long long key, size_t hint);
+
+    long long removed_before(size_t k, long long orig_pos) const;
+
+    vector<long long> starts;      // početak intervala (originalno)
+    vector<long long> ends;        // kraj intervala (originalno)
+    vector<long long> prefix;      // broj lowercase baza ispred intervala k
+    vector<long long> comp_start;  // komprimirana pozicija prve uppercase baze iza intervala k
+};
@@ -0,0 +1,80 @@
+#include "./dinuc_cache.hpp"
+
+#include <cstring>
+
+
+string dinuc_cache_path(const string& output_dir, int chr) {
+    return output_dir + "/" + to_string(chr) + "_dinuc.bin";
+}
+
+
+void encode_dinucleotides(const PackedSequence& s, vector<uint8_t>& O) {
+    O.clear();
+    append_dinucleotides(s, 1, s.size(), O);
+}
+
+
+bool write_dinuc_cache(const string& path, int chr, const vector<uint8_t>& O, uint64_t source_checksum) {
+    ofstream out(path, ios::binary | ios::trunc);
+    if (!out) return false;
+
+    DinucCacheHeader header;
+    memcpy(header.magic, DINUC_CACHE_MAGIC, sizeof(header.magic));
+    header.version = DINUC_CACHE_VERSION;
+    header.chromosome = chr;
+    header.count = O.size();
+    header.checksum = checksum64(O.data(), O.size());
+    header.source_checksum = source_checksum;
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(O.data()), O.size());
+    out.close();
+    return !out.fail();
+}
+
+
+bool read_dinuc_cache_header(const string& path, DinucCacheHeader& header) {
+    ifstream in(path, ios::binary);
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+    return memcmp(header.magic, DINUC_CACHE_MAGIC, sizeof(header.magic)) == 0 && header.version == DINUC_CACHE_VERSION;
+}
+
+
+bool DinucCache::open(const string& path, int chr, uint64_t source_checksum) {
+    owned.clear();
+    obs = ObsView();
+    if (!file.open(path) || file.size() < sizeof(DinucCacheHeader)) return false;
+
+    DinucCacheHeader header;
+    memcpy(&header, file.data(), sizeof(header));
+    if (memcmp(header.magic, DINUC_CACHE_MAGIC, sizeof(header.magic)) != 0) return false;
+    if (header.version != DINUC_CACHE_VERSION || header.chromosome != chr) return false;
+    if (header.source_checksum != source_checksum) return false;
+    if (file.size() != sizeof(DinucCacheHeader) + header.count) return false;
+
+    const uint8_t* payload = reinterpret_cast<const uint8_t*>(file.data() + sizeof(DinucCacheHeader));
+    if (checksum64(payload, header.count) != header.checksum) return false;
+
+    obs = ObsView(payload, header.count);
+    return true;
+}
+
+
+void DinucCache::build(const PackedSequence& s) {
+    file.close();
+    encode_dinucleotides(s, owned);
+    obs = ObsView(owned);
+}
+
+
+void load_or_build_dinuc_cache(const string& output_dir, const GenomeStore& store, int chr, DinucCache& cache) {
+    const GenomeStoreEntry* e = store.entry(chr);
+    const string path = dinuc_cache_path(output_dir, chr);
+    if (cache.open(path, chr, e->checksum)) return;
+
+    cerr << "Upozorenje: cache opažanja " << path << " ne postoji ili nije valjan, gradim ga ponovno" << endl;
+    cache.build(store.sequence(chr));
+    if (!write_dinuc_cache(path, chr, cache.data(), e->checksum)) {
+        cerr << "Upozorenje: ne mogu zapisati " << path << endl;
+    }
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "../utils/structs_consts_functions.hpp"
+#include "../utils/checksum.hpp"
+#include "./mapped_file.hpp"
+#include "./genome_store.hpp"
+
+using namespace std;
+
+
+/**
+ * Trajni cache dinukleotidnih opažanja jednog kromosoma (<chr>_dinuc.bin).
+ *
+ * Sadrži ista opažanja koja bi se dobila kodiranjem komprimirane sekvence
+ * (dinukleotidi koji dodiruju N se preskaču), ali kao uint8_t po opažanju.
+ * Gradi se jednom u predobradi i mapira se izravno u train i decode fazi.
+ *
+ * Raspored datoteke: DinucCacheHeader, zatim count bajtova opažanja.
+ *
+ * checksum        - Checksum64 opažanja (provjera integriteta)
+ * source_checksum - checksum zapisa kromosoma u spremniku genoma iz kojeg je
+ *                   cache izgrađen (provjera je li cache zastario)
+ */
+constexpr char DINUC_CACHE_MAGIC[8] = {'C', 'P', 'G', 'D', 'I', 'N', 'U', 'C'};
+constexpr uint32_t DINUC_CACHE_VERSION = 1;
+
+struct DinucCacheHeader {
+    char magic[8];
+    uint32_t version;
+    int32_t chromosome;
+    uint64_t count;
+    uint64_t checksum;
+    uint64_t source_checksum;
+};
+
+static_assert(sizeof(DinucCacheHeader) == 40, "neočekivan raspored DinucCacheHeader");
+
+
+/**
+ * @brief Putanja do cache datoteke kromosoma u izlaznom direktoriju.
+ */
+string dinuc_cache_path(const string& output_dir, int chr);
+
+
+/**
+ * @brief Kodira cijelu pakiranu sekvencu u dinukleotidna opažanja.
+ */
+void encode_dinucleotides(const PackedSequence& s, vector<uint8_t>& O);
+
+
+/**
+ * @brief Zapisuje cache datoteku.
+ *
+ * @return false ako se datoteka ne može zapisati
+ */
+bool write_dinuc_cache(const string& path, int chr, const vector<uint8_t>& O, uint64_t source_checksum);
+
+
+/**
+ * @brief Čita samo header cache datoteke (bez provjere opažanja).
+ *
+ * @return false ako datoteka ne postoji ili nije cache opažanja
+ */
+bool read_dinuc_cache_header(const string& path, DinucCacheHeader& header);
+
+
+/**
+ * @brief Dinukleotidna opažanja kromosoma, mapirana iz cache datoteke ili
+ * (ako cache nije valjan) kodirana u memoriji.
+ */
+class DinucCache {
+public:
+    /**
+     * @brief Mapira cache i provjerava magic, kromosom, izvorni checksum i checksum opažanja.
+     *
+     * @return false ako cache ne postoji, oštećen je ili je izgrađen iz drugog genoma
+     */
+    bool open(const string& path, int chr, uint64_t source_checksum);
+
+    /**
+     * @brief Kodira opažanja iz spremnika u memoriju (bez datoteke).
+     */
+    void build(const PackedSequence& s);
+
+    const vector<uint8_t>& data() const { return owned; }
+    ObsView observations() const { return obs; }
+
+private:
+    MappedFile file;
+    vector<uint8_t> owned;
+    ObsView obs;
+};
+
+
+/**
+ * @brief Otvara cache kromosoma; ako ne postoji ili nije valjan, kodira opažanja
+ * iz spremnika genoma i pokušava ponovno zapisati cache.
+ *
+ * @param output_dir Izlazni direktorij predobrade
+ * @param store Otvoreni spremnik genoma
+ * @param chr Broj kromosoma
+ * @param cache Izlazni cache
+ */
+void load_or_build_dinuc_cache(const string& output_dir, const GenomeStore& store, int chr, DinucCache& cache);
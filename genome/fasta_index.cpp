@@ -0,0 +1,203 @@
+#include "./fasta_index.hpp"
+
+#include <cstring>
+#include <sys/stat.h>
+
+
+int parse_chromosome_number(string_view header) {
+    const string_view key = "chromosome ";
+    size_t pos = header.find(key);
+    if (pos == string_view::npos) return -1;
+    pos += key.size();
+
+    size_t digits_end = pos;
+    while (digits_end < header.size() && isdigit((unsigned char)header[digits_end])) digits_end++;
+    if (digits_end == pos) return -1;
+
+    // broj mora biti cijela riječ: "chromosome 1," ili "chromosome 1 ..." ali ne "chromosome 1X"
+    if (digits_end < header.size() && header[digits_end] != ',' && header[digits_end] != ' ') return -1;
+
+    return stoi(string(header.substr(pos, digits_end - pos)));
+}
+
+
+void FaiBuilder::add_header(string_view header, long long next_offset) {
+    size_t name_end = header.find_first_of(" \t\r", 1);
+    if (name_end == string_view::npos) name_end = header.size();
+
+    index.push_back({
+        string(header.substr(1, name_end - 1)),
+        0, next_offset, 0, 0,
+        parse_chromosome_number(header)
+    });
+    saw_short_line = false;
+}
+
+
+void FaiBuilder::add_line(string_view line) {
+    if (index.empty()) return;  // sekvenca prije prvog headera se ne indeksira
+
+    FaiRecord& rec = index.back();
+    int bytes = (int)line.size() + 1;
+    int bases = (!line.empty() && line.back() == '\r') ? (int)line.size() - 1 : (int)line.size();
+
+    if (rec.line_bases == 0) {
+        rec.line_bases = bases;
+        rec.line_bytes = bytes;
+    } else if (saw_short_line || bases > rec.line_bases || bytes - bases != rec.line_bytes - rec.line_bases) {
+        // samo zadnja linija zapisa smije biti kraća
+        ok = false;
+    }
+
+    if (bases < rec.line_bases) saw_short_line = true;
+    rec.length += bases;
+}
+
+
+bool FaiBuilder::finish(vector<FaiRecord>& records) {
+    for (auto& rec : index) {
+        // prazni zapisi: samtools konvencija
+        if (rec.line_bases == 0) {
+            rec.line_bases = 1;
+            rec.line_bytes = 2;
+        }
+    }
+    records = move(index);
+    index.clear();
+    return ok;
+}
+
+
+bool build_fai(string_view fasta, vector<FaiRecord>& records) {
+    FaiBuilder builder;
+    size_t pos = 0;
+
+    while (pos < fasta.size()) {
+        const char* nl = static_cast<const char*>(memchr(fasta.data() + pos, '\n', fasta.size() - pos));
+        size_t end = nl ? (size_t)(nl - fasta.data()) : fasta.size();
+        string_view line = fasta.substr(pos, end - pos);
+
+        if (!line.empty() && line[0] == '>') {
+            builder.add_header(line, (long long)end + 1);
+        } else {
+            builder.add_line(line);
+        }
+        pos = end + 1;
+    }
+
+    return builder.finish(records);
+}
+
+
+bool load_fai(const string& path, vector<FaiRecord>& records) {
+    ifstream in(path);
+    if (!in) return false;
+
+    records.clear();
+    string line;
+    while (getline(in, line)) {
+        if (line.empty()) continue;
+        istringstream fields(line);
+        FaiRecord rec;
+        if (!getline(fields, rec.name, '\t')) return false;
+        if (!(fields >> rec.length >> rec.offset >> rec.line_bases >> rec.line_bytes)) return false;
+        rec.chromosome = -1;
+        records.push_back(rec);
+    }
+    return true;
+}
+
+
+bool save_fai(const string& path, const vector<FaiRecord>& records) {
+    ofstream out(path);
+    if (!out) return false;
+
+    for (const auto& rec : records) {
+        out << rec.name << '\t' << rec.length << '\t' << rec.offset << '\t'
+            << rec.line_bases << '\t' << rec.line_bytes << '\n';
+    }
+    return (bool)out;
+}
+
+
+bool GenomeProvider::open(const string& fasta_path) {
+    if (!fasta.open(fasta_path)) {
+        cerr << "Ne mogu mapirati FASTA datoteku: " << fasta_path << endl;
+        return false;
+    }
+
+    const string fai_path = fasta_path + ".fai";
+    struct stat fa_st, fai_st;
+    bool fresh = stat(fasta_path.c_str(), &fa_st) == 0
+              && stat(fai_path.c_str(), &fai_st) == 0
+              && fai_st.st_mtime >= fa_st.st_mtime;
+
+    if (!fresh || !load_fai(fai_path, index)) {
+        fasta.advise_sequential();
+        if (!build_fai(fasta.view(), index)) {
+            cerr << "FASTA datoteka nema konzistentne duljine linija, ne može se indeksirati: " << fasta_path << endl;
+            return false;
+        }
+        if (!save_fai(fai_path, index)) {
+            cerr << "Upozorenje: ne mogu spremiti indeks " << fai_path << endl;
+        }
+        return true;
+    }
+
+    // broj kromosoma nije dio .fai formata; čita se iz headera ispred svakog zapisa
+    string_view data = fasta.view();
+    for (auto& rec : index) {
+        if (rec.offset <= 0 || rec.offset > (long long)data.size()) return false;
+        size_t header_end = (size_t)rec.offset - 1;
+        size_t header_start = data.rfind('>', header_end);
+        if (header_start == string_view::npos) return false;
+        rec.chromosome = parse_chromosome_number(data.substr(header_start, header_end - header_start));
+    }
+    return true;
+}
+
+
+const FaiRecord* GenomeProvider::find(const string& name) const {
+    for (const auto& rec : index) {
+        if (rec.name == name) return &rec;
+    }
+    return nullptr;
+}
+
+
+const FaiRecord* GenomeProvider::find_chromosome(int chr_number) const {
+    for (const auto& rec : index) {
+        if (rec.chromosome == chr_number) return &rec;
+    }
+    return nullptr;
+}
+
+
+SequenceView GenomeProvider::sequence(const FaiRecord& rec) const {
+    return region(rec, 1, rec.length);
+}
+
+
+SequenceView GenomeProvider::region(const FaiRecord& rec, long long start, long long end) const {
+    start = max(1LL, start);
+    end = min(rec.length, end);
+
+    SequenceView view;
+    view.line_bases = rec.line_bases;
+    view.line_bytes = rec.line_bytes;
+    if (end < start) {
+        view.data = fasta.data() + rec.offset;
+        return view;
+    }
+
+    long long first = start - 1;
+    view.column = first % rec.line_bases;
+    view.data = fasta.data() + rec.offset + (first / rec.line_bases) * rec.line_bytes + view.column;
+    view.length = end - start + 1;
+    return view;
+}
+
+
+long long GenomeProvider::record_bytes(const FaiRecord& rec) {
+    return (rec.length / rec.line_bases) * rec.line_bytes + rec.length % rec.line_bases;
+}
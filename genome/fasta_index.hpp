@@ -0,0 +1,201 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <cctype>
+
+#include "./mapped_file.hpp"
+
+using namespace std;
+
+
+/**
+ * Jedan zapis samtools .fai indeksa (NAME, LENGTH, OFFSET, LINEBASES, LINEWIDTH).
+ *
+ * name        - ime zapisa (prva riječ headera bez '>')
+ * length      - broj baza u zapisu
+ * offset      - bajt pozicija prve baze u FASTA datoteci
+ * line_bases  - broj baza po liniji
+ * line_bytes  - broj bajtova po liniji (uključuje '\n', odnosno "\r\n")
+ * chromosome  - broj kromosoma iz headera ili -1 (ne sprema se u .fai, računa se iz headera)
+ */
+struct FaiRecord {
+    string name;
+    long long length;
+    long long offset;
+    int line_bases;
+    int line_bytes;
+    int chromosome;
+};
+
+
+/**
+ * Iz FASTA headera izvlači broj kromosoma. Broj se traži iza "chromosome " i mora
+ * biti cijela riječ (završava zarezom, razmakom ili krajem linije), tako da se
+ * npr. "chromosome 1" ne poklapa s "chromosome 1X" ili "chromosome 10".
+ *
+ * @param header FASTA header linija
+ *
+ * @return int Broj kromosoma ili -1 ako header ne opisuje numerirani kromosom
+ */
+int parse_chromosome_number(string_view header);
+
+
+/**
+ * @brief Inkrementalna izgradnja .fai indeksa dok se FASTA čita liniju po liniju.
+ * Koristi se i pri skeniranju mapirane datoteke i tijekom jednog prolaza predobrade,
+ * tako da indeks nastaje bez dodatnog čitanja genoma.
+ */
+class FaiBuilder {
+public:
+    /**
+     * @param header Header linija (s '>' i bez '\n')
+     * @param next_offset Bajt pozicija odmah iza headera (prva baza zapisa)
+     */
+    void add_header(string_view header, long long next_offset);
+
+    /**
+     * @param line Linija sekvence bez '\n' (može završavati s '\r')
+     */
+    void add_line(string_view line);
+
+    /**
+     * @brief Vraća izgrađeni indeks.
+     *
+     * @param records Izlazni vektor zapisa
+     * @return false ako datoteka nema konzistentne duljine linija pa se ne može indeksirati
+     */
+    bool finish(vector<FaiRecord>& records);
+
+private:
+    vector<FaiRecord> index;
+    bool ok = true;
+    bool saw_short_line = false;
+};
+
+
+/**
+ * @brief Gradi .fai indeks skeniranjem (mapirane) FASTA datoteke.
+ *
+ * @param fasta Sadržaj FASTA datoteke
+ * @param records Izlazni vektor zapisa
+ * @return false ako se datoteka ne može indeksirati (nekonzistentne linije)
+ */
+bool build_fai(string_view fasta, vector<FaiRecord>& records);
+
+
+/**
+ * @brief Učitava samtools .fai indeks. Polje chromosome se postavlja na -1.
+ *
+ * @return false ako datoteka ne postoji ili nije ispravnog formata
+ */
+bool load_fai(const string& path, vector<FaiRecord>& records);
+
+
+/**
+ * @brief Sprema indeks u samtools .fai formatu.
+ *
+ * @return false ako se datoteka ne može zapisati
+ */
+bool save_fai(const string& path, const vector<FaiRecord>& records);
+
+
+/**
+ * @brief Pogled na dio FASTA zapisa unutar mapirane datoteke, bez kopiranja.
+ * Baze unutar zapisa prelamaju se u linije, pa se pozicija računa preko
+ * line_bases/line_bytes. Ako je cijela regija unutar jedne linije, contiguous()
+ * je true i može se dobiti izravan string_view.
+ *
+ * Indeksiranje je 0-based relativno na početak regije.
+ */
+struct SequenceView {
+    const char* data = nullptr;  // prva baza regije
+    long long length = 0;        // broj baza u regiji
+    long long column = 0;        // stupac prve baze unutar njezine linije
+    int line_bases = 1;
+    int line_bytes = 1;
+
+    long long size() const { return length; }
+
+    char operator[](long long i) const {
+        long long k = column + i;
+        return data[(k / line_bases) * line_bytes + (k % line_bases) - column];
+    }
+
+    bool contiguous() const { return column + length <= line_bases; }
+
+    string_view as_string_view() const { return string_view(data, (size_t)length); }
+
+    /**
+     * @brief Poziva f(const char* ptr, size_t n) za svaki kontinuirani komad
+     * regije (najviše jedna linija), redom od početka.
+     */
+    template <class F>
+    void for_each_segment(F f) const {
+        const char* p = data;
+        long long remaining = length;
+        long long col = column;
+        while (remaining > 0) {
+            long long n = min(remaining, (long long)line_bases - col);
+            f(p, (size_t)n);
+            remaining -= n;
+            p += n + (line_bytes - line_bases);
+            col = 0;
+        }
+    }
+};
+
+
+/**
+ * @brief Pristup genomu po kromosomima i regijama preko mapirane FASTA datoteke
+ * i samtools .fai indeksa. Indeks se čita iz <fasta>.fai ako postoji i nije stariji
+ * od FASTA datoteke, inače se gradi skeniranjem i sprema pokraj nje.
+ */
+class GenomeProvider {
+public:
+    /**
+     * @brief Mapira FASTA datoteku i učitava ili gradi njen indeks.
+     *
+     * @param fasta_path Putanja do (nekomprimirane) FASTA datoteke
+     * @return false ako se datoteka ne može otvoriti ili indeksirati
+     */
+    bool open(const string& fasta_path);
+
+    const vector<FaiRecord>& records() const { return index; }
+    const MappedFile& file() const { return fasta; }
+
+    /**
+     * @brief Traži zapis po imenu (prva riječ headera). Vraća nullptr ako ne postoji.
+     */
+    const FaiRecord* find(const string& name) const;
+
+    /**
+     * @brief Traži prvi zapis numeriranog kromosoma. Vraća nullptr ako ne postoji.
+     */
+    const FaiRecord* find_chromosome(int chr_number) const;
+
+    /**
+     * @brief Pogled na cijeli zapis.
+     */
+    SequenceView sequence(const FaiRecord& rec) const;
+
+    /**
+     * @brief Pogled na regiju [start, end] zapisa (1-based, uključivo). Granice se
+     * režu na duljinu zapisa.
+     */
+    SequenceView region(const FaiRecord& rec, long long start, long long end) const;
+
+    /**
+     * @brief Broj bajtova koje baze zapisa zauzimaju u datoteci (od rec.offset).
+     */
+    static long long record_bytes(const FaiRecord& rec);
+
+private:
+    MappedFile fasta;
+    vector<FaiRecord> index;
+};
@@ -0,0 +1,190 @@
+#include "./fasta_scan.hpp"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FASTA_SCAN_X86 1
+#endif
+
+
+namespace {
+
+constexpr size_t BLOCK = 64;
+
+/**
+ * Maske bloka od 64 bajta: bit i je postavljen ako je bajt i veliko slovo (upper),
+ * odnosno veliko slovo koje nije A/C/G/T (non_acgt).
+ */
+struct BlockMasks {
+    uint64_t upper;
+    uint64_t non_acgt;
+};
+
+using MaskFn = BlockMasks (*)(const char*);
+
+
+BlockMasks masks_scalar_n(const char* p, size_t n) {
+    BlockMasks m = {0, 0};
+    for (size_t i = 0; i < n; i++) {
+        char c = p[i];
+        if (c >= 'A' && c <= 'Z') {
+            m.upper |= 1ULL << i;
+            if (c != 'A' && c != 'C' && c != 'G' && c != 'T') m.non_acgt |= 1ULL << i;
+        }
+    }
+    return m;
+}
+
+
+BlockMasks masks_scalar(const char* p) { return masks_scalar_n(p, BLOCK); }
+
+
+#ifdef FASTA_SCAN_X86
+
+__attribute__((target("sse2")))
+BlockMasks masks_sse2(const char* p) {
+    const __m128i lo = _mm_set1_epi8('A' - 1), hi = _mm_set1_epi8('Z' + 1);
+    const __m128i a = _mm_set1_epi8('A'), c = _mm_set1_epi8('C');
+    const __m128i g = _mm_set1_epi8('G'), t = _mm_set1_epi8('T');
+
+    BlockMasks m = {0, 0};
+    for (int k = 0; k < 4; k++) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * k));
+        __m128i up = _mm_and_si128(_mm_cmpgt_epi8(v, lo), _mm_cmpgt_epi8(hi, v));
+        __m128i acgt = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, a), _mm_cmpeq_epi8(v, c)),
+                                    _mm_or_si128(_mm_cmpeq_epi8(v, g), _mm_cmpeq_epi8(v, t)));
+        m.upper |= (uint64_t)(uint32_t)_mm_movemask_epi8(up) << (16 * k);
+        m.non_acgt |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_andnot_si128(acgt, up)) << (16 * k);
+    }
+    return m;
+}
+
+
+__attribute__((target("avx2")))
+BlockMasks masks_avx2(const char* p) {
+    const __m256i lo = _mm256_set1_epi8('A' - 1), hi = _mm256_set1_epi8('Z' + 1);
+    const __m256i a = _mm256_set1_epi8('A'), c = _mm256_set1_epi8('C');
+    const __m256i g = _mm256_set1_epi8('G'), t = _mm256_set1_epi8('T');
+
+    BlockMasks m = {0, 0};
+    for (int k = 0; k < 2; k++) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32 * k));
+        __m256i up = _mm256_and_si256(_mm256_cmpgt_epi8(v, lo), _mm256_cmpgt_epi8(hi, v));
+        __m256i acgt = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, a), _mm256_cmpeq_epi8(v, c)),
+                                       _mm256_or_si256(_mm256_cmpeq_epi8(v, g), _mm256_cmpeq_epi8(v, t)));
+        m.upper |= (uint64_t)(uint32_t)_mm256_movemask_epi8(up) << (32 * k);
+        m.non_acgt |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_andnot_si256(acgt, up)) << (32 * k);
+    }
+    return m;
+}
+
+#endif
+
+
+struct Implementation {
+    MaskFn masks;
+    const char* name;
+};
+
+
+Implementation select_implementation() {
+#ifdef FASTA_SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return {masks_avx2, "avx2"};
+    if (__builtin_cpu_supports("sse2")) return {masks_sse2, "sse2"};
+#endif
+    return {masks_scalar, "scalar"};
+}
+
+
+const Implementation& implementation() {
+    static const Implementation impl = select_implementation();
+    return impl;
+}
+
+
+/**
+ * @brief Obrađuje blok od len <= 64 bajta s maskom velikih slova u. Granice
+ * lowercase regija nalaze se preko ctz nad maskom, a završeni raspon velikih
+ * slova kopira se odjednom.
+ *
+ * @param span_start Početak trenutnog raspona velikih slova u liniji (vrijedi kad nismo u lowercase regiji)
+ */
+inline void scan_block(
+    const char* line, size_t base, uint64_t u, size_t len,
+    char* upper_out, size_t& out, size_t& span_start,
+    SoftMaskState& state, vector<lowerCaseRegions>& lowercase
+) {
+    const uint64_t valid = (len == 64) ? ~0ULL : ((1ULL << len) - 1);
+    size_t i = 0;
+
+    while (i < len) {
+        if (state.in_lowercase) {
+            uint64_t m = (u & valid) >> i;
+            if (m == 0) break;
+            size_t t = (size_t)__builtin_ctzll(m);
+            i += t;
+            lowercase.push_back({state.start, (int)(state.pos + base + i) - 1});
+            state.in_lowercase = false;
+            span_start = base + i;
+        } else {
+            uint64_t m = (~u & valid) >> i;
+            if (m == 0) break;
+            size_t t = (size_t)__builtin_ctzll(m);
+            i += t;
+            size_t span = base + i - span_start;
+            memcpy(upper_out + out, line + span_start, span);
+            out += span;
+            state.start = (int)(state.pos + base + i);
+            state.in_lowercase = true;
+        }
+    }
+}
+
+}  // namespace
+
+
+LineScan scan_fasta_line(const char* line, size_t n, char* upper_out, SoftMaskState& state, vector<lowerCaseRegions>& lowercase) {
+    const MaskFn masks = implementation().masks;
+    size_t out = 0;
+    size_t non_acgt = 0;
+    size_t span_start = 0;
+
+    size_t base = 0;
+    for (; base + BLOCK <= n; base += BLOCK) {
+        BlockMasks m = masks(line + base);
+        non_acgt += (size_t)__builtin_popcountll(m.non_acgt);
+        scan_block(line, base, m.upper, BLOCK, upper_out, out, span_start, state, lowercase);
+    }
+    if (base < n) {
+        BlockMasks m = masks_scalar_n(line + base, n - base);
+        non_acgt += (size_t)__builtin_popcountll(m.non_acgt);
+        scan_block(line, base, m.upper, n - base, upper_out, out, span_start, state, lowercase);
+    }
+
+    // raspon velikih slova koji traje do kraja linije
+    if (!state.in_lowercase) {
+        memcpy(upper_out + out, line + span_start, n - span_start);
+        out += n - span_start;
+    }
+
+    state.pos += (long long)n;
+    return {out, non_acgt};
+}
+
+
+size_t count_uppercase(const char* data, size_t n) {
+    const MaskFn masks = implementation().masks;
+    size_t count = 0;
+
+    size_t base = 0;
+    for (; base + BLOCK <= n; base += BLOCK) count += (size_t)__builtin_popcountll(masks(data + base).upper);
+    if (base < n) count += (size_t)__builtin_popcountll(masks_scalar_n(data + base, n - base).upper);
+    return count;
+}
+
+
+const char* fasta_scan_implementation() {
+    return implementation().name;
+}
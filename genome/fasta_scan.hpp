@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "../utils/structs_consts_functions.hpp"
+
+using namespace std;
+
+
+/**
+ * Obrada linija FASTA sekvence u jednom prolazu: klasifikacija velikih/malih
+ * slova, granice soft-mask (lowercase) regija, skupno kopiranje velikih slova
+ * i brojanje simbola koji nisu A/C/G/T.
+ *
+ * Maske se računaju po blokovima od 64 bajta (AVX2 ili SSE2, odabire se pri
+ * pokretanju prema procesoru), a granice regija traže se preko maski
+ * (count trailing zeros) umjesto znak po znak. Skalarna verzija daje iste maske,
+ * pa je rezultat identičan na svakom procesoru.
+ *
+ * "Veliko slovo" je A-Z, kao isupper() u "C" lokalizaciji.
+ */
+
+
+/**
+ * Stanje soft-mask regija koje se prenosi između linija jednog zapisa.
+ *
+ * pos          - originalna pozicija (1-based) sljedeće baze
+ * in_lowercase - jesmo li unutar lowercase regije
+ * start        - početak trenutne lowercase regije
+ */
+struct SoftMaskState {
+    long long pos = 1;
+    bool in_lowercase = false;
+    int start = -1;
+
+    /**
+     * @brief Zatvara otvorenu lowercase regiju na kraju zapisa.
+     */
+    void finish(vector<lowerCaseRegions>& lowercase) {
+        if (in_lowercase) lowercase.push_back({start, (int)pos - 1});
+        in_lowercase = false;
+    }
+};
+
+
+/**
+ * Rezultat obrade linije.
+ *
+ * upper    - broj kopiranih velikih slova
+ * non_acgt - koliko ih nije A/C/G/T (N i ostali IUPAC kodovi)
+ */
+struct LineScan {
+    size_t upper;
+    size_t non_acgt;
+};
+
+
+/**
+ * @brief Obrađuje jednu liniju sekvence (bez '\n'). Velika slova se redom kopiraju
+ * u upper_out (mora imati mjesta za n znakova), a završene lowercase regije
+ * (1-based, originalne koordinate) dodaju u lowercase.
+ */
+LineScan scan_fasta_line(const char* line, size_t n, char* upper_out, SoftMaskState& state, vector<lowerCaseRegions>& lowercase);
+
+
+/**
+ * @brief Broj velikih slova (A-Z) u bloku memorije.
+ */
+size_t count_uppercase(const char* data, size_t n);
+
+
+/**
+ * @brief Ime odabrane implementacije ("avx2", "sse2" ili "scalar").
+ */
+const char* fasta_scan_implementation();
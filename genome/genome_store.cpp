@@ -0,0 +1,332 @@
+#include "./genome_store.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+
+bool PackedSequence::is_n(long long i) const {
+    // prvi N-interval koji završava na ili iza pozicije (1-based i + 1)
+    const lowerCaseRegions* end = n_runs + n_run_count;
+    const lowerCaseRegions* it = lower_bound(n_runs, end, i + 1,
+        [](const lowerCaseRegions& r, long long pos) { return r.end < pos; });
+    return it != end && it->start <= i + 1;
+}
+
+
+void PackedSequence::decode(long long start, long long end, string& out) const {
+    out.clear();
+    if (end <= start) return;
+    out.reserve((size_t)(end - start));
+
+    for (long long i = start; i < end; i++) out.push_back("ACGT"[code(i)]);
+
+    // N-regije koje se preklapaju s [start, end)
+    const lowerCaseRegions* runs_end = n_runs + n_run_count;
+    const lowerCaseRegions* it = lower_bound(n_runs, runs_end, start + 1,
+        [](const lowerCaseRegions& r, long long pos) { return r.end < pos; });
+    for (; it != runs_end && it->start <= end; it++) {
+        long long a = max(start, (long long)it->start - 1);
+        long long b = min(end, (long long)it->end);
+        for (long long i = a; i < b; i++) out[(size_t)(i - start)] = 'N';
+    }
+}
+
+
+void append_dinucleotides(const PackedSequence& s, long long start, long long end, vector<uint8_t>& O) {
+    start = max(1LL, start);
+    end = min(s.length, end);
+    if (end - start + 1 < 2) return;
+    O.reserve(O.size() + (size_t)(end - start));
+
+    // prva N-regija koja završava na ili iza baze start
+    const lowerCaseRegions* run = s.n_runs;
+    const lowerCaseRegions* runs_end = s.n_runs + s.n_run_count;
+    run = lower_bound(run, runs_end, start,
+        [](const lowerCaseRegions& r, long long pos) { return r.end < pos; });
+
+    int prev = s.code(start - 1);
+    for (long long pos = start + 1; pos <= end; pos++) {
+        int cur = s.code(pos - 1);
+
+        // dinukleotid pokriva baze [pos - 1, pos]
+        while (run != runs_end && run->end < pos - 1) run++;
+        bool touches_n = run != runs_end && run->start <= pos;
+
+        if (!touches_n) O.push_back((uint8_t)((prev << 2) | cur));
+        prev = cur;
+    }
+}
+
+
+long long invalid_dinucleotides_before(const PackedSequence& s, long long d) {
+    const long long T_full = s.length - 1;
+    d = min(d, T_full);
+    long long invalid = 0;
+
+    // N-regija [a, b] (1-based baze) poništava dinukleotide [a - 2, b - 1];
+    // regije su razdvojene barem jednom bazom pa se ti rasponi ne preklapaju
+    for (size_t k = 0; k < s.n_run_count; k++) {
+        long long first = max(0LL, (long long)s.n_runs[k].start - 2);
+        long long last = min(T_full - 1, (long long)s.n_runs[k].end - 1);
+        if (first >= d) break;
+        invalid += min(last, d - 1) - first + 1;
+    }
+    return invalid;
+}
+
+
+void pack_bases(const char* bases, size_t n, long long first, uint8_t* packed, vector<lowerCaseRegions>& n_runs) {
+    uint8_t* out = packed + first / 4;
+
+    for (size_t k = 0; k < n; k += 4) {
+        uint8_t byte = 0;
+        size_t m = min((size_t)4, n - k);
+
+        for (size_t j = 0; j < m; j++) {
+            int code = base_index(bases[k + j]);
+            if (code < 0) {
+                int pos = (int)(first + k + j + 1);
+                if (!n_runs.empty() && n_runs.back().end == pos - 1) n_runs.back().end = pos;
+                else n_runs.push_back({pos, pos});
+                code = 0;
+            }
+            byte |= (uint8_t)(code << (2 * j));
+        }
+        *out++ = byte;
+    }
+}
+
+
+void append_runs(vector<lowerCaseRegions>& runs, const vector<lowerCaseRegions>& next) {
+    auto it = next.begin();
+    if (it != next.end() && !runs.empty() && runs.back().end + 1 == it->start) {
+        runs.back().end = it->end;
+        it++;
+    }
+    runs.insert(runs.end(), it, next.end());
+}
+
+
+bool GenomeStoreWriter::open(const string& path, int num_chromosomes) {
+    out.open(path, ios::binary | ios::trunc);
+    if (!out) return false;
+
+    entries.assign(num_chromosomes, GenomeStoreEntry{});
+    current = -1;
+
+    // mjesto za header i direktorij, upisuju se u close()
+    vector<char> zeros(sizeof(GenomeStoreHeader) + num_chromosomes * sizeof(GenomeStoreEntry), 0);
+    out.write(zeros.data(), zeros.size());
+    return (bool)out;
+}
+
+
+void GenomeStoreWriter::pad_to_8() {
+    static const char zeros[8] = {0};
+    long long pos = (long long)out.tellp();
+    if (pos % 8) out.write(zeros, 8 - pos % 8);
+}
+
+
+void GenomeStoreWriter::flush_packed() {
+    checksum.update(packed.data(), packed.size());
+    out.write(reinterpret_cast<const char*>(packed.data()), packed.size());
+    packed.clear();
+}
+
+
+void GenomeStoreWriter::begin_chromosome(int chr) {
+    current = chr - 1;
+    pad_to_8();
+
+    GenomeStoreEntry& e = entries[current];
+    e.chromosome = chr;
+    e.bases_offset = (uint64_t)out.tellp();
+
+    cur_byte = 0;
+    cur_bits = 0;
+    cur_length = 0;
+    n_runs.clear();
+    checksum = Checksum64();
+    packed.reserve(1 << 20);
+}
+
+
+void GenomeStoreWriter::append_bases(const char* bases, size_t n, bool acgt_only) {
+    size_t k = 0;
+
+    if (acgt_only) {
+        // A=0x41, C=0x43, G=0x47, T=0x54: bitovi 1-2 daju 0, 1, 3, 2, pa G i T zamijenimo
+        auto code = [](char c) { int x = (c >> 1) & 3; return x ^ (x >> 1); };
+
+        // do poravnanja na cijeli bajt, zatim po četiri baze
+        for (; k < n && cur_bits != 0; k++) {
+            cur_byte |= (uint8_t)(code(bases[k]) << cur_bits);
+            cur_bits += 2;
+            if (cur_bits == 8) {
+                packed.push_back(cur_byte);
+                cur_byte = 0;
+                cur_bits = 0;
+            }
+        }
+        for (; k + 4 <= n; k += 4) {
+            packed.push_back((uint8_t)(code(bases[k]) | (code(bases[k + 1]) << 2) |
+                                       (code(bases[k + 2]) << 4) | (code(bases[k + 3]) << 6)));
+            if (packed.size() >= (1 << 20)) flush_packed();
+        }
+        cur_length += (long long)k;
+    }
+
+    for (; k < n; k++) {
+        int code = base_index(bases[k]);
+        cur_length++;
+
+        if (code < 0) {
+            // baze koje nisu A/C/G/T pamte se kao N-regije, a pakiraju kao 0
+            if (!n_runs.empty() && n_runs.back().end == cur_length - 1) n_runs.back().end = (int)cur_length;
+            else n_runs.push_back({(int)cur_length, (int)cur_length});
+            code = 0;
+        }
+
+        cur_byte |= (uint8_t)(code << cur_bits);
+        cur_bits += 2;
+        if (cur_bits == 8) {
+            packed.push_back(cur_byte);
+            cur_byte = 0;
+            cur_bits = 0;
+            if (packed.size() >= (1 << 20)) flush_packed();
+        }
+    }
+}
+
+
+void GenomeStoreWriter::end_chromosome(const vector<lowerCaseRegions>& lowercase, long long original_length) {
+    if (cur_bits > 0) packed.push_back(cur_byte);
+    flush_packed();
+
+    GenomeStoreEntry& e = entries[current];
+    e.length = (uint64_t)cur_length;
+    e.original_length = (uint64_t)original_length;
+
+    pad_to_8();
+    e.n_runs_offset = (uint64_t)out.tellp();
+    e.n_run_count = n_runs.size();
+    out.write(reinterpret_cast<const char*>(n_runs.data()), n_runs.size() * sizeof(lowerCaseRegions));
+
+    e.lowercase_offset = (uint64_t)out.tellp();
+    e.lowercase_count = lowercase.size();
+    out.write(reinterpret_cast<const char*>(lowercase.data()), lowercase.size() * sizeof(lowerCaseRegions));
+
+    checksum.update(n_runs.data(), n_runs.size() * sizeof(lowerCaseRegions));
+    checksum.update(lowercase.data(), lowercase.size() * sizeof(lowerCaseRegions));
+    e.checksum = checksum.value();
+
+    current = -1;
+}
+
+
+void GenomeStoreWriter::write_chromosome(int chr, const PackedChromosome& c) {
+    begin_chromosome(chr);
+
+    checksum.update(c.packed.data(), c.packed.size());
+    out.write(reinterpret_cast<const char*>(c.packed.data()), c.packed.size());
+    cur_length = c.length;
+    n_runs = c.n_runs;
+
+    end_chromosome(c.lowercase, c.original_length);
+}
+
+
+bool GenomeStoreWriter::close() {
+    GenomeStoreHeader header;
+    memcpy(header.magic, GENOME_STORE_MAGIC, sizeof(header.magic));
+    header.version = GENOME_STORE_VERSION;
+    header.num_chromosomes = (uint32_t)entries.size();
+
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(GenomeStoreEntry));
+    out.close();
+    return !out.fail();
+}
+
+
+namespace {
+
+/**
+ * Je li raspon od count elemenata veličine elem na offsetu unutar datoteke
+ * veličine size (bez preljeva pri množenju).
+ */
+bool range_in_file(uint64_t offset, uint64_t count, uint64_t elem, uint64_t size) {
+    return offset <= size && count <= (size - offset) / elem;
+}
+
+}  // namespace
+
+
+bool GenomeStore::open(const string& path) {
+    if (!file.open(path)) return false;
+    if (file.size() < sizeof(GenomeStoreHeader)) return false;
+
+    const GenomeStoreHeader* header = reinterpret_cast<const GenomeStoreHeader*>(file.data());
+    if (memcmp(header->magic, GENOME_STORE_MAGIC, sizeof(header->magic)) != 0) return false;
+    if (header->version != GENOME_STORE_VERSION) return false;
+    if (file.size() < sizeof(GenomeStoreHeader) + header->num_chromosomes * sizeof(GenomeStoreEntry)) return false;
+
+    // skraćen ili zastario spremnik: svi rasponi zapisa moraju biti unutar datoteke
+    const GenomeStoreEntry* e = reinterpret_cast<const GenomeStoreEntry*>(file.data() + sizeof(GenomeStoreHeader));
+    const uint64_t size = file.size();
+    for (uint32_t i = 0; i < header->num_chromosomes; i++) {
+        if (e[i].length > (uint64_t)LLONG_MAX - 3) return false;
+        if (!range_in_file(e[i].bases_offset, (e[i].length + 3) / 4, 1, size)) return false;
+        if (!range_in_file(e[i].n_runs_offset, e[i].n_run_count, sizeof(lowerCaseRegions), size)) return false;
+        if (!range_in_file(e[i].lowercase_offset, e[i].lowercase_count, sizeof(lowerCaseRegions), size)) return false;
+    }
+
+    count = header->num_chromosomes;
+    entries = e;
+    return true;
+}
+
+
+const GenomeStoreEntry* GenomeStore::entry(int chr) const {
+    for (uint32_t i = 0; i < count; i++) {
+        if (entries[i].chromosome == chr) return &entries[i];
+    }
+    return nullptr;
+}
+
+
+PackedSequence GenomeStore::sequence(int chr) const {
+    PackedSequence seq;
+    const GenomeStoreEntry* e = entry(chr);
+    if (e == nullptr) return seq;
+
+    seq.packed = reinterpret_cast<const uint8_t*>(file.data() + e->bases_offset);
+    seq.length = (long long)e->length;
+    seq.n_runs = reinterpret_cast<const lowerCaseRegions*>(file.data() + e->n_runs_offset);
+    seq.n_run_count = (size_t)e->n_run_count;
+    return seq;
+}
+
+
+vector<lowerCaseRegions> GenomeStore::lowercase_regions(int chr) const {
+    const GenomeStoreEntry* e = entry(chr);
+    if (e == nullptr) return {};
+
+    const lowerCaseRegions* first = reinterpret_cast<const lowerCaseRegions*>(file.data() + e->lowercase_offset);
+    return vector<lowerCaseRegions>(first, first + e->lowercase_count);
+}
+
+
+void open_genome_store_or_exit(const string& path, GenomeStore& store, int chr) {
+    if (!store.open(path)) {
+        cerr << "Ne mogu otvoriti spremnik genoma: " << path << endl;
+        exit(1);
+    }
+    if (store.entry(chr) == nullptr) {
+        cerr << "Kromosom " << chr << " ne postoji u spremniku " << path << endl;
+        exit(1);
+    }
+}
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "../utils/structs_consts_functions.hpp"
+#include "../utils/checksum.hpp"
+#include "./mapped_file.hpp"
+
+using namespace std;
+
+
+/**
+ * Binarni spremnik genoma (zamjena za <chr>_train_chr.txt / <chr>_test_chr.txt).
+ *
+ * Za svaki kromosom sprema se komprimirana sekvenca (samo velika slova, kao u
+ * dosadašnjim txt datotekama) pakirana na 2 bita po bazi, tablica N-regija
+ * (baze koje nisu A/C/G/T) i tablica lowercase intervala u originalnim
+ * koordinatama, tako da se originalne koordinate mogu rekonstruirati.
+ *
+ * Raspored datoteke:
+ *  - GenomeStoreHeader
+ *  - GenomeStoreEntry[num_chromosomes]   (direktorij s offsetima)
+ *  - po kromosomu: pakirane baze, N-regije, lowercase intervali (poravnato na 8 bajtova)
+ *
+ * Kodiranje baza: A=0, C=1, G=2, T=3 (isto kao di_index), baza i je u bajtu i/4
+ * na bitovima 2*(i%4). Dinukleotid (x, y) je tada izravno (x << 2) | y.
+ */
+constexpr char GENOME_STORE_MAGIC[8] = {'C', 'P', 'G', 'S', 'T', 'O', 'R', 'E'};
+constexpr uint32_t GENOME_STORE_VERSION = 2;
+
+struct GenomeStoreHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_chromosomes;
+};
+
+struct GenomeStoreEntry {
+    int32_t chromosome;          // broj kromosoma, 0 ako zapis nije pronađen u genomu
+    uint32_t reserved;
+    uint64_t length;             // broj baza komprimirane sekvence
+    uint64_t original_length;    // broj baza u originalnom zapisu (s malim slovima)
+    uint64_t bases_offset;       // offset pakiranih baza
+    uint64_t n_runs_offset;      // offset tablice N-regija (lowerCaseRegions, 1-based, komprimirane koordinate)
+    uint64_t n_run_count;
+    uint64_t lowercase_offset;   // offset tablice lowercase intervala (1-based, originalne koordinate)
+    uint64_t lowercase_count;
+    uint64_t checksum;           // Checksum64 pakiranih baza, N-regija i lowercase intervala
+};
+
+static_assert(sizeof(GenomeStoreHeader) == 16, "neočekivan raspored GenomeStoreHeader");
+static_assert(sizeof(GenomeStoreEntry) == 72, "neočekivan raspored GenomeStoreEntry");
+static_assert(sizeof(lowerCaseRegions) == 8, "lowerCaseRegions se sprema izravno u spremnik");
+
+
+/**
+ * @brief Pogled na pakiranu sekvencu jednog kromosoma unutar mapiranog spremnika.
+ * Indeksiranje je 0-based.
+ */
+struct PackedSequence {
+    const uint8_t* packed = nullptr;
+    long long length = 0;
+    const lowerCaseRegions* n_runs = nullptr;  // sortirane, 1-based, uključivo
+    size_t n_run_count = 0;
+
+    long long size() const { return length; }
+
+    /**
+     * @brief 2-bitni kod baze na poziciji i (N baze vraćaju 0, provjeriti is_n).
+     */
+    int code(long long i) const { return (packed[i >> 2] >> ((i & 3) << 1)) & 3; }
+
+    /**
+     * @brief Je li baza na poziciji i unutar N-regije (binarno pretraživanje).
+     */
+    bool is_n(long long i) const;
+
+    /**
+     * @brief Baza na poziciji i kao znak (A/C/G/T ili N).
+     */
+    char operator[](long long i) const { return is_n(i) ? 'N' : "ACGT"[code(i)]; }
+
+    /**
+     * @brief Dekodira baze [start, end) (0-based) u string.
+     */
+    void decode(long long start, long long end, string& out) const;
+};
+
+
+/**
+ * @brief Dodaje u O dinukleotidna opažanja (indeksi 0..15, vidi di_index) za sve
+ * dinukleotide čije su obje baze unutar [start, end] (1-based, uključivo).
+ * Dinukleotidi koji dodiruju N-regiju se preskaču, kao i kod di_index() == -1.
+ */
+void append_dinucleotides(const PackedSequence& s, long long start, long long end, vector<uint8_t>& O);
+
+
+/**
+ * @brief Broj dinukleotida s indeksom manjim od d (0-based; dinukleotid d pokriva baze
+ * d+1 i d+2, 1-based) koji dodiruju N-regiju i zato nemaju opažanje. Indeks opažanja
+ * dinukleotida d u nizu iz append_dinucleotides(s, 1, ...) je d - invalid_dinucleotides_before(s, d).
+ */
+long long invalid_dinucleotides_before(const PackedSequence& s, long long d);
+
+
+/**
+ * @brief Kromosom pakiran u memoriji (npr. paralelno, po dijelovima), spreman za
+ * GenomeStoreWriter::write_chromosome.
+ */
+struct PackedChromosome {
+    long long length = 0;                // broj baza komprimirane sekvence
+    long long original_length = 0;       // broj baza u originalnom zapisu
+    vector<uint8_t> packed;              // (length + 3) / 4 bajtova
+    vector<lowerCaseRegions> n_runs;     // 1-based, komprimirane koordinate
+    vector<lowerCaseRegions> lowercase;  // 1-based, originalne koordinate
+};
+
+
+/**
+ * @brief Pakira n baza (samo velika slova) koje počinju na poziciji first komprimirane
+ * sekvence (0-based, djeljivo s 4) u packed[first / 4 ...] i dodaje njihove N-regije u
+ * n_runs. Dijelovi iste sekvence mogu se pakirati neovisno i spojiti s append_runs.
+ */
+void pack_bases(const char* bases, size_t n, long long first, uint8_t* packed, vector<lowerCaseRegions>& n_runs);
+
+
+/**
+ * @brief Dodaje intervale iz next na kraj runs. Interval koji se nastavlja točno na
+ * zadnji interval u runs spaja se s njim, kao da su oba dijela obrađena u jednom prolazu.
+ */
+void append_runs(vector<lowerCaseRegions>& runs, const vector<lowerCaseRegions>& next);
+
+
+/**
+ * @brief Sekvencijalno zapisivanje spremnika tijekom jednog prolaza kroz genom.
+ * Baze se pakiraju i zapisuju odmah, a direktorij se upisuje na kraju.
+ */
+class GenomeStoreWriter {
+public:
+    /**
+     * @return false ako se datoteka ne može otvoriti
+     */
+    bool open(const string& path, int num_chromosomes);
+
+    void begin_chromosome(int chr);
+
+    /**
+     * @brief Dodaje baze komprimirane sekvence (samo velika slova).
+     *
+     * @param acgt_only Pozivatelj jamči da su sve baze A/C/G/T (npr. scan_fasta_line
+     *                  nije našao druge simbole), pa se preskače provjera N-regija
+     */
+    void append_bases(const char* bases, size_t n, bool acgt_only = false);
+
+    /**
+     * @brief Završava kromosom i zapisuje njegove tablice.
+     *
+     * @param lowercase Lowercase intervali (1-based, originalne koordinate)
+     * @param original_length Broj baza u originalnom zapisu
+     */
+    void end_chromosome(const vector<lowerCaseRegions>& lowercase, long long original_length);
+
+    /**
+     * @brief Zapisuje već pakirani kromosom jednim velikim zapisom. Rezultat je isti
+     * kao begin_chromosome + append_bases + end_chromosome nad istim bazama.
+     */
+    void write_chromosome(int chr, const PackedChromosome& c);
+
+    /**
+     * @brief Upisuje direktorij i zatvara datoteku.
+     */
+    bool close();
+
+private:
+    void pad_to_8();
+    void flush_packed();
+
+    ofstream out;
+    vector<GenomeStoreEntry> entries;
+    int current = -1;
+
+    vector<uint8_t> packed;          // međuspremnik pakiranih baza
+    uint8_t cur_byte = 0;
+    int cur_bits = 0;
+    long long cur_length = 0;
+    vector<lowerCaseRegions> n_runs;
+    Checksum64 checksum;
+};
+
+
+/**
+ * @brief Mapirani spremnik genoma. Sekvence se ne učitavaju u memoriju nego
+ * se stranice dohvaćaju tek kad im se pristupi.
+ */
+class GenomeStore {
+public:
+    /**
+     * @return false ako datoteka ne postoji ili nije ispravan spremnik (i ako
+     *         baze, N-regije ili lowercase intervali nekog zapisa izlaze iz datoteke)
+     */
+    bool open(const string& path);
+
+    /**
+     * @return nullptr ako kromosom ne postoji u spremniku
+     */
+    const GenomeStoreEntry* entry(int chr) const;
+
+    PackedSequence sequence(int chr) const;
+
+    vector<lowerCaseRegions> lowercase_regions(int chr) const;
+
+private:
+    MappedFile file;
+    const GenomeStoreEntry* entries = nullptr;
+    uint32_t count = 0;
+};
+
+
+/**
+ * @brief Otvara spremnik i provjerava postoji li traženi kromosom; u suprotnom
+ * ispisuje grešku i prekida program.
+ */
+void open_genome_store_or_exit(const string& path, GenomeStore& store, int chr);
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+
+using namespace std;
+
+
+/**
+ * @brief Read-only memorijski mapirana datoteka (mmap). Sadržaj je dostupan
+ * bez kopiranja u std::string; OS učitava stranice tek kad im se pristupi.
+ *
+ * Objekt se može premještati, ali ne i kopirati. Mapiranje se otpušta u destruktoru.
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    /**
+     * @brief Mapira datoteku u memoriju (samo za čitanje).
+     *
+     * @param path Putanja do datoteke
+     * @return true ako je mapiranje uspjelo (prazna datoteka je valjana, size() == 0)
+     */
+    bool open(const string& path);
+
+    /**
+     * @brief Otpušta mapiranje.
+     */
+    void close();
+
+    /**
+     * @brief Savjetuje OS-u da će se datoteka čitati slijedno (read-ahead).
+     */
+    void advise_sequential() const;
+
+    bool is_open() const { return opened; }
+    const char* data() const { return ptr; }
+    size_t size() const { return len; }
+    string_view view() const { return string_view(ptr, len); }
+
+private:
+    const char* ptr = nullptr;
+    size_t len = 0;
+    bool opened = false;
+};
@@ -0,0 +1,153 @@
+#include "./workspace_manifest.hpp"
+
+
+const ChromosomeManifest* WorkspaceManifest::find(int chr) const {
+    for (const auto& c : chromosomes) {
+        if (c.chromosome == chr) return &c;
+    }
+    return nullptr;
+}
+
+
+string manifest_path(const string& output_dir) {
+    return output_dir + "/manifest.txt";
+}
+
+
+bool build_manifest(const string& output_dir, int num_chromosomes, WorkspaceManifest& manifest) {
+    GenomeStore store;
+    AnnotationIndex annotations;
+    if (!store.open(output_dir + "/genome_store.bin")) return false;
+    if (!annotations.open(output_dir + "/cpg_index.bin")) return false;
+
+    manifest = WorkspaceManifest();
+    manifest.annotation_count = (long long)annotations.count();
+    manifest.annotation_checksum = annotations.checksum();
+
+    for (int chr = 1; chr <= num_chromosomes; chr++) {
+        const GenomeStoreEntry* e = store.entry(chr);
+        if (e == nullptr) continue;
+
+        ChromosomeManifest c;
+        c.chromosome = chr;
+        c.length = (long long)e->original_length;
+        c.compressed_length = (long long)e->length;
+        c.lowercase_runs = (long long)e->lowercase_count;
+        c.n_runs = (long long)e->n_run_count;
+        c.store_checksum = e->checksum;
+        c.bases_offset = (long long)e->bases_offset;
+        c.n_runs_offset = (long long)e->n_runs_offset;
+        c.lowercase_offset = (long long)e->lowercase_offset;
+
+        DinucCacheHeader dinuc;
+        if (read_dinuc_cache_header(dinuc_cache_path(output_dir, chr), dinuc)) {
+            c.dinuc_count = (long long)dinuc.count;
+            c.dinuc_checksum = dinuc.checksum;
+        }
+
+        const AnnotationIndexEntry* a = annotations.entry(chr);
+        if (a != nullptr) {
+            c.cpg_offset = (long long)a->offset;
+            c.cpg_count = (long long)a->count;
+        }
+        manifest.chromosomes.push_back(c);
+    }
+    return true;
+}
+
+
+bool save_manifest(const string& path, const WorkspaceManifest& manifest) {
+    ofstream out(path);
+    if (!out) return false;
+
+    out << "# manifest izlaznog direktorija predobrade (vidi genome/workspace_manifest.hpp)\n";
+    out << "version " << WORKSPACE_MANIFEST_VERSION << "\n";
+    out << "annotation " << manifest.annotation_count << " " << hex << manifest.annotation_checksum << dec << "\n";
+    out << "# chromosome chr length compressed_length lowercase_runs n_runs store_checksum"
+           " bases_offset n_runs_offset lowercase_offset dinuc_count dinuc_checksum cpg_offset cpg_count\n";
+
+    for (const auto& c : manifest.chromosomes) {
+        out << "chromosome " << c.chromosome << " " << c.length << " " << c.compressed_length << " "
+            << c.lowercase_runs << " " << c.n_runs << " "
+            << hex << c.store_checksum << dec << " "
+            << c.bases_offset << " " << c.n_runs_offset << " " << c.lowercase_offset << " "
+            << c.dinuc_count << " " << hex << c.dinuc_checksum << dec << " "
+            << c.cpg_offset << " " << c.cpg_count << "\n";
+    }
+    out.close();
+    return !out.fail();
+}
+
+
+bool load_manifest(const string& path, WorkspaceManifest& manifest) {
+    ifstream file(path);
+    if (!file) return false;
+
+    manifest = WorkspaceManifest();
+    bool version_ok = false;
+    string line, key;
+
+    while (getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        istringstream in(line);
+        in >> key;
+
+        if (key == "version") {
+            int version = 0;
+            in >> version;
+            version_ok = (version == WORKSPACE_MANIFEST_VERSION);
+        } else if (key == "annotation") {
+            in >> manifest.annotation_count >> hex >> manifest.annotation_checksum >> dec;
+        } else if (key == "chromosome") {
+            ChromosomeManifest c;
+            in >> c.chromosome >> c.length >> c.compressed_length >> c.lowercase_runs >> c.n_runs
+               >> hex >> c.store_checksum >> dec
+               >> c.bases_offset >> c.n_runs_offset >> c.lowercase_offset
+               >> c.dinuc_count >> hex >> c.dinuc_checksum >> dec
+               >> c.cpg_offset >> c.cpg_count;
+            manifest.chromosomes.push_back(c);
+        }
+        if (in.fail()) return false;
+    }
+    return version_ok;
+}
+
+
+const ChromosomeManifest& load_manifest_or_exit(const string& output_dir, int chr, WorkspaceManifest& manifest) {
+    const string path = manifest_path(output_dir);
+    if (!load_manifest(path, manifest)) {
+        cerr << "Ne mogu učitati manifest " << path << ", pokrenite predobradu" << endl;
+        exit(1);
+    }
+    const ChromosomeManifest* c = manifest.find(chr);
+    if (c == nullptr) {
+        cerr << "Kromosom " << chr << " ne postoji u manifestu " << path << endl;
+        exit(1);
+    }
+    return *c;
+}
+
+
+bool check_workspace(const string& output_dir, const GenomeStore& store, int chr) {
+    const string path = manifest_path(output_dir);
+    WorkspaceManifest manifest;
+    if (!load_manifest(path, manifest)) {
+        cerr << "Upozorenje: manifest " << path << " ne postoji, ulazne datoteke se ne mogu provjeriti" << endl;
+        return false;
+    }
+
+    bool ok = true;
+    const ChromosomeManifest* c = manifest.find(chr);
+    const GenomeStoreEntry* e = store.entry(chr);
+    if (c == nullptr || e == nullptr || c->store_checksum != e->checksum) {
+        cerr << "Upozorenje: spremnik genoma za kromosom " << chr << " ne odgovara manifestu (zastarjele datoteke?)" << endl;
+        ok = false;
+    }
+
+    AnnotationIndex annotations;
+    if (!annotations.open(output_dir + "/cpg_index.bin") || annotations.checksum() != manifest.annotation_checksum) {
+        cerr << "Upozorenje: indeks anotacija ne odgovara manifestu (zastarjele datoteke?)" << endl;
+        ok = false;
+    }
+    return ok;
+}
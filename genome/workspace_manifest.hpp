@@ -0,0 +1,96 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "./genome_store.hpp"
+#include "./dinuc_cache.hpp"
+#include "./annotation_index.hpp"
+
+using namespace std;
+
+
+/**
+ * Manifest izlaznog direktorija predobrade (manifest.txt).
+ *
+ * Za svaki kromosom bilježi osnovne podatke koje kasnije faze inače dobivaju
+ * čitanjem velikih datoteka (duljine, broj lowercase i N-regija), checksume
+ * sadržaja i offsete u binarnim datotekama. Kasnije faze iz njega čitaju duljine
+ * bez otvaranja sekvenci i provjeravaju jesu li ulazne datoteke zastarjele
+ * (npr. spremnik genoma ponovno izgrađen bez ponovnog pokretanja cijele predobrade).
+ *
+ * Format je tekstualni, jedna stavka po liniji; linije koje počinju s '#' su komentari:
+ *   version 1
+ *   annotation <broj otoka> <checksum>
+ *   chromosome <chr> <length> <compressed_length> <lowercase_runs> <n_runs> <store_checksum>
+ *              <bases_offset> <n_runs_offset> <lowercase_offset> <dinuc_count> <dinuc_checksum>
+ *              <cpg_offset> <cpg_count>
+ * Checksumi su zapisani heksadecimalno.
+ */
+constexpr int WORKSPACE_MANIFEST_VERSION = 1;
+
+struct ChromosomeManifest {
+    int chromosome = 0;
+    long long length = 0;              // originalna duljina (s malim slovima)
+    long long compressed_length = 0;   // duljina komprimirane sekvence (samo velika slova)
+    long long lowercase_runs = 0;
+    long long n_runs = 0;
+    uint64_t store_checksum = 0;       // checksum zapisa u genome_store.bin
+    long long bases_offset = 0;        // offseti u genome_store.bin
+    long long n_runs_offset = 0;
+    long long lowercase_offset = 0;
+    long long dinuc_count = 0;         // broj opažanja u <chr>_dinuc.bin
+    uint64_t dinuc_checksum = 0;
+    long long cpg_offset = 0;          // otoci kromosoma u cpg_index.bin
+    long long cpg_count = 0;
+};
+
+struct WorkspaceManifest {
+    long long annotation_count = 0;
+    uint64_t annotation_checksum = 0;
+    vector<ChromosomeManifest> chromosomes;
+
+    /**
+     * @return nullptr ako kromosom nije u manifestu
+     */
+    const ChromosomeManifest* find(int chr) const;
+};
+
+
+string manifest_path(const string& output_dir);
+
+
+/**
+ * @brief Skuplja manifest iz spremnika genoma, headera cache datoteka opažanja
+ * i indeksa anotacija u izlaznom direktoriju.
+ *
+ * @return false ako spremnik genoma ili indeks anotacija ne postoje
+ */
+bool build_manifest(const string& output_dir, int num_chromosomes, WorkspaceManifest& manifest);
+
+bool save_manifest(const string& path, const WorkspaceManifest& manifest);
+
+/**
+ * @return false ako datoteka ne postoji ili nije ispravnog formata
+ */
+bool load_manifest(const string& path, WorkspaceManifest& manifest);
+
+
+/**
+ * @brief Učitava manifest i provjerava postoji li kromosom; u suprotnom ispisuje
+ * grešku i prekida program.
+ */
+const ChromosomeManifest& load_manifest_or_exit(const string& output_dir, int chr, WorkspaceManifest& manifest);
+
+
+/**
+ * @brief Uspoređuje otvoreni spremnik genoma i indeks anotacija s manifestom.
+ * Ako se ne podudaraju (ili manifest ne postoji), ispisuje upozorenje.
+ *
+ * @return true ako su ulazne datoteke za kromosom u skladu s manifestom
+ */
+bool check_workspace(const string& output_dir, const GenomeStore& store, int chr);
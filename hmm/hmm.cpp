@@ -18,24 +18,37 @@ vector<string> load_sequences(const string &filename) {
 }
 
 
-string load_background(const string &filename) {
+void load_background_counts(const string &filename, long long counts[NSYM]) {
     ifstream file(filename);
     if (!file) {
         cerr << "Ne mogu otvoriti background: " << filename << endl;
         exit(1);
     }
 
-    string genome, line;
-    while (getline(file, line)) {
-        genome += line;
+    for (int k = 0; k < NSYM; k++) counts[k] = 0;
+
+    string dinuc;
+    long long count;
+    while (file >> dinuc >> count) {
+        int idx = (dinuc.size() == 2) ? di_index(dinuc[0], dinuc[1]) : -1;
+        if (idx == -1) {
+            cerr << "Neispravan zapis u " << filename << ": " << dinuc << endl;
+            exit(1);
+        }
+        counts[idx] = count;
     }
-    return genome;
 }
 
 
-vector<CpgRegion> load_all_or_selected_coords(int chromosome) {
+vector<CpgRegion> load_all_or_selected_coords(const string& output_dir, int chromosome) {
+    // indeks daje otoke kromosoma izravno, bez parsiranja i filtriranja cijele datoteke
+    AnnotationIndex index;
+    if (index.open(output_dir + "/cpg_index.bin")) {
+        return (chromosome == 0) ? index.all() : index.regions(chromosome);
+    }
+
     vector<CpgRegion> coords;
-    string filename = "../output/coords.txt";
+    string filename = output_dir + "/coords.txt";
     ifstream file(filename);
     if (!file) {
         cerr << "Ne mogu otvoriti coords fajl: " << filename << endl;
@@ -80,16 +93,7 @@ void compute_emission_pos(const vector<string> &seqs, double emit[NSYM]) {
 
 
 
-void compute_emission_bg(const string &bg, double emit[NSYM]) {
-    long long counts[NSYM] = {0};
-
-    if ((int)bg.size() >= 2) {
-        for (int i = 1; i < (int)bg.size(); i++) {
-            int idx = di_index(bg[i - 1], bg[i]);
-            if (idx != -1) counts[idx]++;
-        }
-    }
-
+void compute_emission_bg(const long long counts[NSYM], double emit[NSYM]) {
     long long total = 0;
     for (int k = 0; k < NSYM; k++) total += counts[k];
 
@@ -9,6 +9,7 @@
 #include <iomanip>
 
 #include "../utils/structs_consts_functions.hpp"
+#include "../genome/annotation_index.hpp"
 
 using namespace std;
 
@@ -25,26 +26,27 @@ vector<string> load_sequences(const string &filename);
 
 
 /**
- * @brief Učitava genom oćišćen od CpG otoka i malih slova iz .txt doteteke
+ * @brief Učitava brojeve dinukleotida pozadinskog genoma (oćišćenog od CpG otoka i
+ * malih slova) iz .txt doteteke, jedna linija po dinukleotidu ("AA 123")
  * 
  * @param filename Ime doteteke
- * @return string Sekvenca pozadinskog genoma
- * 
- * Napomena: Pretpostavlja se da je sekvenca već očišćena i spremna za upotrebu.
+ * @param counts Niz od 16 elemenata za pohranu brojeva (indeksi kao di_index)
  */
-string load_background(const string &filename);
+void load_background_counts(const string &filename, long long counts[NSYM]);
 
 
 /**
- * @brief Učitava koordinate CpG otoka iz doteteke. Ako je dan broj kromosoma
+ * @brief Učitava koordinate CpG otoka iz binarnog indeksa anotacija (cpg_index.bin),
+ * ili iz coords.txt ako indeks ne postoji. Ako je dan broj kromosoma
  * između [1, 22], učitava koordinate vezane za samo taj kromosom. Ako je dana 0,
- * učitava sve koordinate genoma.
+ * učitava sve koordinate genoma. Iz indeksa su otoci sortirani po početku.
  * 
+ * @param output_dir Direktorij s izlazima predobrade (cpg_index.bin, coords.txt)
  * @param chromosome Broj kromosoma (1-22) ili 0 za sve kromosome
  * 
  * Napomena: Pretpostavlja se da je doteteka ispravno formatirana.
  */
-vector<CpgRegion> load_all_or_selected_coords(int chromosome);
+vector<CpgRegion> load_all_or_selected_coords(const string& output_dir, int chromosome);
 
 
 /**
@@ -57,12 +59,13 @@ void compute_emission_pos(const vector<string> &seqs, double emit[NSYM]);
 
 
 /**
- * @brief Računa emisijske vjerojatnosti za pozadinsko stanje na temelju pozadinskog genoma
+ * @brief Računa emisijske vjerojatnosti za pozadinsko stanje na temelju brojeva
+ * dinukleotida pozadinskog genoma
  * 
- * @param bg Sekvenca pozadinskog genoma
- * @param emit Niz od 4 elementa za pohranu vjerojatnosti A,C,G,T
+ * @param counts Brojevi dinukleotida pozadine (vidi load_background_counts)
+ * @param emit Niz od 16 elemenata za pohranu vjerojatnosti dinukleotida
  */
-void compute_emission_bg(const string &bg, double emit[NSYM]);
+void compute_emission_bg(const long long counts[NSYM], double emit[NSYM]);
 
 
 /**
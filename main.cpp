@@ -1,10 +1,11 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <cstring>
 
 using namespace std;
 
-int main() {
+int main(int argc, char* argv[]) {
 
     const int NUM_TRAIN_CHR = 16;   // 1–16 train
     const int NUM_TOTAL_CHR = 22;   // ukupno kromosoma
@@ -19,10 +20,12 @@ int main() {
 
     cout << "\n[3/4] Treniranje HMM (Baum-Welch)\n";
 
-    for (int chr = 1; chr <= NUM_TRAIN_CHR; chr++) {
-        cout << "\n--- Treniranje na kromosomu " << chr << " ---\n";
-        system("./bin/train");
+    // svi trening kromosomi u jednom procesu; "--sequential" trenira redom po kromosomima
+    string train_cmd = "./bin/train --chromosomes 1-" + to_string(NUM_TRAIN_CHR);
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--sequential") == 0) train_cmd += " --sequential";
     }
+    system(train_cmd.c_str());
 
 
     cout << "\n[4/4] Dekodiranje i evaluacija\n";
@@ -15,9 +15,10 @@ void keep_and_clip(vector<CpgRegion>& islands, int keep_start_bp, int keep_end_b
 }
 
 
+template <class Real>
 void trim_islands_with_posterior(
     vector<CpgRegion>& islands,
-    const vector<double>& posterior_c,
+    const vector<Real>& posterior_c,
     int base_shift,
     double trim_th
 ) {
@@ -46,21 +47,8 @@ void trim_islands_with_posterior(
     islands.swap(trimmed);
 }
 
-
-void load_chr_seq_to_dinuc_vector(vector<int>& O, string& s, int chr_number) {
-    ifstream in("../output/" + to_string(chr_number) + "_test_chr.txt");
-    if (!in) {
-        cerr << "Ne mogu otvoriti test fajl za kromosom " << chr_number << "\n";
-        exit(1);
-    }
-    getline(in, s);
-
-    O.reserve(s.size() - 1);
-    for (size_t i = 1; i < s.size(); i++) {
-        int x = di_index(s[i - 1], s[i]);
-        if (x != -1) O.push_back(x);
-    }
-}
+template void trim_islands_with_posterior<float>(vector<CpgRegion>&, const vector<float>&, int, double);
+template void trim_islands_with_posterior<double>(vector<CpgRegion>&, const vector<double>&, int, double);
 
 
 void extract_cpg_islands(vector<CpgRegion>& islands, vector<int>& states) {
@@ -81,34 +69,18 @@ void extract_cpg_islands(vector<CpgRegion>& islands, vector<int>& states) {
 }
 
 
-void move_predicted_based_on_lowercase(vector<CpgRegion>& predicted, int chr_number) {
-    vector<CpgRegion> lowercaseCoords;
-    ifstream in("../output/" + to_string(chr_number) + "_test_chr.txt");
-    string s;
-    getline(in, s);
-
-    while(getline(in, s)) {
-        size_t space = s.find(' ', 0);
-        int start = stoll(s.substr(0, space));
-        int end   = stoll(s.substr(space + 1, s.size() - space - 1));
-        lowercaseCoords.push_back({start, end});
-    }
-
-
-    for (auto& p : predicted) {
-        int offset = 0;
+void move_predicted_based_on_lowercase(vector<CpgRegion>& predicted, const CoordinateMap& map) {
+    vector<long long> starts;
+    starts.reserve(predicted.size());
+    for (const auto& p : predicted) starts.push_back(p.start);
 
-        for (const auto& lc : lowercaseCoords) {
-            if (lc.start <= p.start + offset) {
-                offset += (lc.end - lc.start + 1);
-            } else {
-                break;
-            }
-        }
-
-        p.start += offset;
-        p.end += offset;
+    // otoci dolaze redom po prozorima pa je skupno preslikavanje gotovo linearno
+    map.to_original(starts);
 
+    for (size_t i = 0; i < predicted.size(); i++) {
+        int offset = (int)(starts[i] - predicted[i].start);
+        predicted[i].start += offset;
+        predicted[i].end += offset;
     }
 }
 
@@ -142,11 +114,12 @@ void filter_lenght_and_merge_close_islands(vector<CpgRegion>& islands) {
 }
 
 
-void filter_by_content(const string& sequence, vector<CpgRegion>& islands) {
+void filter_by_content(const PackedSequence& sequence, vector<CpgRegion>& islands) {
     if (islands.empty()) return;
 
     vector<CpgRegion> filtered;
     filtered.reserve(islands.size());
+    string bases;
 
     for (const auto& region : islands) {
         int start = max(1, region.start);
@@ -158,9 +131,10 @@ void filter_by_content(const string& sequence, vector<CpgRegion>& islands) {
         int count_g = 0;
         int count_cg = 0;
 
+        sequence.decode(start - 1, end, bases);
+
         char prev = '\0';
-        for (int pos = start; pos <= end; pos++) {
-            char base = toupper(sequence[(size_t)(pos - 1)]);
+        for (char base : bases) {
             if (base == 'C') count_c++;
             if (base == 'G') count_g++;
             if (prev == 'C' && base == 'G') count_cg++;
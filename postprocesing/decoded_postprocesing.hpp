@@ -9,6 +9,8 @@
 #include <algorithm>
 
 #include "../utils/structs_consts_functions.hpp"
+#include "../genome/genome_store.hpp"
+#include "../genome/coordinate_map.hpp"
 
 using namespace std;
 
@@ -49,28 +51,15 @@ void keep_and_clip(vector<CpgRegion>& islands, int keep_start_bp, int keep_end_b
  * @param base_shift Globalni pomak baza (početak segmenta u baznim koordinatama)
  * @param trim_th Prag posteriora ispod kojeg se rubovi otoka uklanjaju
  */
+template <class Real>
 void trim_islands_with_posterior(
     vector<CpgRegion>& islands,
-    const vector<double>& posterior_c,
+    const vector<Real>& posterior_c,
     int base_shift,
     double trim_th
 );
 
 
-/**
- * @brief Učitava sekvencu zadanog kromosoma iz datoteke i pretvara je u
- * vektor dinukleotidnih opažanja. Sekvenca se učitava kao string baza (A,C,G,T), 
- * dok se dinukleotidi kodiraju kao cjelobrojni indeksi pomoću funkcije di_index().
- *
- * @param dinucs Referenca na vektor u koji se spremaju dinukleotidni indeksi
- * @param sequence Referenca na string u koji se sprema cijela bazna sekvenca
- * @param chr_number Broj kromosoma koji se učitava
- *
- * @throws runtime_error Ako se ulazna datoteka ne može otvoriti
- */
-void load_chr_seq_to_dinuc_vector(vector<int>& O, string& s, int chr_number);
-
-
 /**
  * @brief Ekstrahira kontinuirane CpG otoke iz vektora tvrdih stanja.
  *
@@ -90,12 +79,13 @@ void extract_cpg_islands(vector<CpgRegion>& islands, vector<int>& states);
 
 
 /**
- * @brief Pomiče predviđene CpG otoke na temelju malih slova u genomu
+ * @brief Pomiče predviđene CpG otoke na temelju malih slova u genomu. Pomak se
+ * računa iz početka otoka (komprimirano -> originalno) i primjenjuje na oba kraja.
  * 
  * @param predicted Vektor predviđenih CpG otoka
- * @param chr_number Broj kromosoma
+ * @param map Mapa koordinata kromosoma (izgrađena iz lowercase regija)
  */
-void move_predicted_based_on_lowercase(vector<CpgRegion>& predicted, int chr_number);
+void move_predicted_based_on_lowercase(vector<CpgRegion>& predicted, const CoordinateMap& map);
 
 
 /**
@@ -120,10 +110,10 @@ void filter_lenght_and_merge_close_islands(vector<CpgRegion>& islands);
  * MIN_GC_CONTENT i MIN_CPG_OE.
  *
  * Koordinate CpG otoka su 1-based i uključive, dok je ulazna sekvenca
- * pohranjena kao 0-based string baza.
+ * 0-based indeksirana pakirana sekvenca.
  *
- * @param sequence Bazna sekvenca kromosoma (A,C,G,T), 0-based indeksirana
+ * @param sequence Pakirana sekvenca kromosoma (A,C,G,T,N), 0-based indeksirana
  * @param islands Vektor CpG otoka u baznim koordinatama (modificira se in-place)
  */
-void filter_by_content(const string& sequence, vector<CpgRegion>& islands);
+void filter_by_content(const PackedSequence& sequence, vector<CpgRegion>& islands);
 
@@ -0,0 +1,85 @@
+#include "./background_counter.hpp"
+
+
+BackgroundCounter::BackgroundCounter(const vector<CpgRegion> &coords) {
+    vector<pair<long long, long long>> regions;
+    regions.reserve(coords.size());
+    for (const auto &r : coords) {
+        //PAZI: UCSC koordinate su 1-based, C++ je 0-based
+        long long a = max(0LL, (long long)r.start - 1);
+        long long b = (long long)r.end - 1;
+        if (a <= b) regions.push_back({a, b});
+    }
+    sort(regions.begin(), regions.end());
+
+    // spajanje preklapajućih i susjednih regija
+    vector<pair<long long, long long>> merged;
+    for (const auto &r : regions) {
+        if (!merged.empty() && r.first <= merged.back().second + 1) {
+            merged.back().second = max(merged.back().second, r.second);
+        } else {
+            merged.push_back(r);
+        }
+    }
+    skip = make_shared<const vector<pair<long long, long long>>>(move(merged));
+}
+
+
+BackgroundCounter BackgroundCounter::at(long long start) const {
+    BackgroundCounter c;
+    c.skip = skip;
+    c.pos = start;
+    c.next = (size_t)(lower_bound(skip->begin(), skip->end(), start,
+        [](const pair<long long, long long> &r, long long p) { return r.second < p; }) - skip->begin());
+    return c;
+}
+
+
+void BackgroundCounter::add_base(char c) {
+    int b = base_index(c);
+    if (kept == 0) first = b;
+    else if (last >= 0 && b >= 0) dinuc[(last << 2) | b]++;
+    last = b;
+    kept++;
+}
+
+
+void BackgroundCounter::add(const char *bases, size_t n) {
+    const vector<pair<long long, long long>> &regions = *skip;
+    size_t k = 0;
+
+    while (k < n) {
+        long long g = pos + (long long)k;
+        while (next < regions.size() && regions[next].second < g) next++;
+
+        // unutar CpG regije: preskačemo ostatak regije odjednom
+        if (next < regions.size() && regions[next].first <= g) {
+            k = (size_t)min((long long)n, regions[next].second + 1 - pos);
+            continue;
+        }
+
+        size_t segment_end = (next < regions.size()) ? (size_t)min((long long)n, regions[next].first - pos) : n;
+        for (; k < segment_end; k++) add_base(bases[k]);
+    }
+    pos += (long long)n;
+}
+
+
+void BackgroundCounter::merge(const BackgroundCounter &other) {
+    if (other.kept == 0) return;
+
+    if (kept > 0 && last >= 0 && other.first >= 0) dinuc[(last << 2) | other.first]++;
+    if (kept == 0) first = other.first;
+
+    for (int k = 0; k < NSYM; k++) dinuc[k] += other.dinuc[k];
+    kept += other.kept;
+    last = other.last;
+}
+
+
+void save_background_counts(ostream &out, const BackgroundCounter &counter) {
+    const char *bases = "ACGT";
+    for (int k = 0; k < NSYM; k++) {
+        out << bases[k >> 2] << bases[k & 3] << " " << counter.counts()[k] << "\n";
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+#include "../utils/structs_consts_functions.hpp"
+
+using namespace std;
+
+
+/**
+ * Brojanje dinukleotida pozadinskog genoma bez spremanja pozadine u memoriju.
+ *
+ * Pozadinski genom su velika slova svih kromosoma redom kako se pojavljuju u
+ * FASTA fajlu, iz kojih su izbačene pozicije CpG otoka (koordinate iz coords,
+ * 1-based, primijenjene na tu spojenu sekvencu). Dinukleotidi se broje nad
+ * preostalom sekvencom, pa su baze s obje strane izbačene regije susjedne.
+ *
+ * Baze se dodaju redom (add); izbačene regije se preskaču cijele, preko
+ * sortiranih i spojenih intervala. Memorija ne ovisi o duljini genoma.
+ */
+class BackgroundCounter {
+public:
+    BackgroundCounter() = default;
+
+    /**
+     * @param coords Koordinate CpG otoka (ne moraju biti sortirane)
+     */
+    explicit BackgroundCounter(const vector<CpgRegion> &coords);
+
+    /**
+     * @brief Prazan brojač koji dijeli regije s ovim, a počinje na poziciji start
+     * spojene sekvence (0-based). Služi za paralelno brojanje dijelova sekvence
+     * koji se zatim redom spajaju s merge.
+     */
+    BackgroundCounter at(long long start) const;
+
+    /**
+     * @brief Dodaje sljedećih n baza spojene sekvence (samo velika slova).
+     */
+    void add(const char *bases, size_t n);
+
+    /**
+     * @brief Dodaje brojeve dijela sekvence koji slijedi odmah iza ovog,
+     * uključujući dinukleotid preko granice dijelova.
+     */
+    void merge(const BackgroundCounter &next);
+
+    /**
+     * @brief Broj baza pozadine nakon izbacivanja CpG otoka.
+     */
+    long long length() const { return kept; }
+
+    const long long *counts() const { return dinuc; }
+
+private:
+    void add_base(char c);
+
+    shared_ptr<const vector<pair<long long, long long>>> skip;  // 0-based, uključivo
+    size_t next = 0;       // prvi interval koji može sadržavati trenutnu poziciju
+    long long pos = 0;     // pozicija sljedeće baze u spojenoj sekvenci
+
+    long long kept = 0;
+    int first = -1;        // kod prve zadržane baze (-1 ako nije A/C/G/T)
+    int last = -1;         // kod zadnje zadržane baze
+    long long dinuc[NSYM] = {0};
+};
+
+
+/**
+ * @brief Sprema brojeve dinukleotida pozadine, jedan dinukleotid po liniji ("AA 123").
+ */
+void save_background_counts(ostream &out, const BackgroundCounter &counter);
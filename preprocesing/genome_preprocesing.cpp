@@ -1,8 +1,8 @@
 #include "./genome_preprocesing.hpp"
 
-vector<string> load_positive_cpg(const string &filename, vector<CpgRegion> &coords) {
-    ifstream file(filename);
-    if (!file) {
+vector<string> load_positive_cpg(const string &filename, vector<CpgRegion> &coords, int threads) {
+    unique_ptr<istream> in = open_input_stream(filename, threads);
+    if (!in) {
         cerr << "Ne mogu otvoriti pozitivan dataset!" << endl;
         exit(1);
     }
@@ -12,6 +12,7 @@ vector<string> load_positive_cpg(const string &filename, vector<CpgRegion> &coor
     string current_seq;
     int chromosome, start, end;
 
+    istream &file = *in;
     while (getline(file, line)) {
         if (line.size() == 0) continue;
 
@@ -56,122 +57,264 @@ vector<string> load_positive_cpg(const string &filename, vector<CpgRegion> &coor
 }
 
 
-string load_chromosome(const string &filename, vector<lowerCaseRegions> &lowercaseCoords, int chr_number) {
-    ifstream file(filename);
-    if (!file) {
+void split_genome(
+    const string &filename,
+    int num_chromosomes,
+    GenomeStoreWriter &genome_store,
+    vector<long> &chromosome_lengths,
+    BackgroundCounter &background,
+    vector<FaiRecord> &fai_records,
+    int threads
+) {
+    unique_ptr<istream> in = open_input_stream(filename, threads);
+    if (!in) {
         cerr << "Ne mogu otvoriti kromosom!" << endl;
         exit(1);
     }
+    istream &file = *in;
+
+    chromosome_lengths.assign(num_chromosomes, 0);
+    vector<char> seen(num_chromosomes, 0);
+
+    string line, upper;
+    vector<lowerCaseRegions> lowercaseCoords;
+    FaiBuilder fai;
+    long long offset = 0;   // bajt pozicija iza trenutne linije, za .fai indeks
+    int chr = -1;           // trenutni kromosom (1-based) ili -1 ako se zapis preskače
+    SoftMaskState mask;
+
+    // zatvara trenutni zapis: sprema lowercase intervale uz pakiranu sekvencu
+    auto finish_record = [&]() {
+        if (chr == -1) return;
+        mask.finish(lowercaseCoords);
 
-    string line, genome;
-    bool in_correct_chr = false;
-    bool in_lowercase = false;
-    int start = -1;
-    int pos = 1;
+        genome_store.end_chromosome(lowercaseCoords, mask.pos - 1);
+
+        lowercaseCoords.clear();
+        chr = -1;
+    };
 
     while (getline(file, line)) {
+        offset += (long long)line.size() + 1;
+        if (line.empty() || line[0] != '>') fai.add_line(line);
         if (line.empty()) continue;
 
         if (line[0] == '>') {
-            if (in_correct_chr) break;
-            if (line.find("chromosome " + to_string(chr_number)) != string::npos) in_correct_chr = true;
-        } else if (in_correct_chr) {
-            for (char c : line) {
-                if (isupper(c)) {
-                    genome.push_back(c);
-
-                    if (in_lowercase) {
-                        lowercaseCoords.push_back({start, pos - 1});
-                        in_lowercase = false;
-                    }
-
-                } else {
-                    if (!in_lowercase) {
-                        start = pos;
-                        in_lowercase = true;
-                    }
-                }
-                pos++;
-            }            
+            finish_record();
+            fai.add_header(line, offset);
+
+            int number = parse_chromosome_number(line);
+            // uzimamo samo prvi zapis svakog kromosoma 1..num_chromosomes
+            if (number >= 1 && number <= num_chromosomes && !seen[number - 1]) {
+                chr = number;
+                seen[chr - 1] = 1;
+                genome_store.begin_chromosome(chr);
+                mask = SoftMaskState();
+            }
+        } else if (chr != -1) {
+            upper.resize(line.size());
+            LineScan scan = scan_fasta_line(line.data(), line.size(), &upper[0], mask, lowercaseCoords);
+
+            genome_store.append_bases(upper.data(), scan.upper, scan.non_acgt == 0);
+            chromosome_lengths[chr - 1] += scan.upper;
+            background.add(upper.data(), scan.upper);
         }
     }
 
-    if (in_lowercase) lowercaseCoords.push_back({start, pos - 1});
-    
-    return genome;
+    finish_record();
+
+    // .fai offseti vrijede samo za nekomprimiranu datoteku
+    if (!fai.finish(fai_records) || detect_input_format(filename) != InputFormat::Plain) fai_records.clear();
+
+    for (int i = 0; i < num_chromosomes; i++) {
+        if (!seen[i]) {
+            cerr << "Upozorenje: kromosom " << i + 1 << " nije pronađen u " << filename << endl;
+        }
+    }
 }
 
 
-string load_background(const string &filename, const vector<CpgRegion> &coords) {
-    ifstream file(filename);
-    if (!file) {
-        cerr << "Ne mogu otvoriti kromosom!" << endl;
-        exit(1);
+bool split_genome_parallel(
+    const string &filename,
+    int num_chromosomes,
+    GenomeStoreWriter &genome_store,
+    vector<long> &chromosome_lengths,
+    BackgroundCounter &background,
+    ThreadPool &pool
+) {
+    const long long PIECE_BYTES = 8 << 20;  // ciljana veličina komada zapisa
+    const long long PACK_BASES = 4 << 20;   // baza po zadatku pakiranja (djeljivo s 4)
+
+    if (detect_input_format(filename) != InputFormat::Plain) return false;
+
+    GenomeProvider genome;
+    if (!genome.open(filename)) return false;
+    const char *data = genome.file().data();
+    const long long file_size = (long long)genome.file().size();
+
+    // prvi zapis svakog kromosoma, redom kako se pojavljuju u fajlu (kao u split_genome)
+    vector<const FaiRecord *> records;
+    for (int chr = 1; chr <= num_chromosomes; chr++) {
+        const FaiRecord *rec = genome.find_chromosome(chr);
+        if (rec == nullptr) continue;
+        // serijski prolaz bi '\r' tretirao kao malo slovo; takve datoteke ostavljamo njemu
+        if (rec->length > 0 && rec->line_bytes != rec->line_bases + 1) return false;
+        records.push_back(rec);
     }
+    sort(records.begin(), records.end(),
+        [](const FaiRecord *a, const FaiRecord *b) { return a->offset < b->offset; });
 
-    string line, genome;
-    while (getline(file, line)) {
-        if (line.size() == 0) continue;
-        if (line[0] == '>') {
-            size_t pos = line.find("chromosome ");
-            if (pos != string::npos) {
-                pos += string("chromosome ").size();
-                try {
-                    stoi(line.substr(pos, pos + 1));
-                    continue;
-                } catch (const invalid_argument &e) {
-                    // naišli smo na zapis kromosoma koji nije 
-                    // broj; prekidamo petlju jer su ostali samo
-                    // X i Y
-                    break;
-                }
-            }
+    // komad zapisa: bajt raspon koji počinje na početku linije
+    struct Piece {
+        size_t record;
+        long long begin, end;       // bajt raspon u datoteci
+        long long first_base;       // originalna pozicija prve baze (0-based)
+        long long upper_offset = 0; // pozicija prvog velikog slova u spojenoj sekvenci
+        long long upper_count = 0;
+        vector<lowerCaseRegions> lowercase;
+        BackgroundCounter counter;
+    };
+
+    vector<Piece> pieces;
+    for (size_t r = 0; r < records.size(); r++) {
+        const FaiRecord &rec = *records[r];
+        if (rec.length == 0) continue;
+
+        long long lines_per_piece = max(1LL, PIECE_BYTES / rec.line_bytes);
+        long long piece_bytes = lines_per_piece * rec.line_bytes;
+        long long end = min(file_size, rec.offset + GenomeProvider::record_bytes(rec));
+        for (long long b = rec.offset; b < end; b += piece_bytes) {
+            Piece p;
+            p.record = r;
+            p.begin = b;
+            p.end = min(end, b + piece_bytes);
+            p.first_base = (b - rec.offset) / rec.line_bytes * rec.line_bases;
+            pieces.push_back(move(p));
         }
+    }
+
+    // 1. prolaz: broj velikih slova po komadu, iz čega slijedi mjesto komada u spojenoj sekvenci
+    pool.parallel_for(pieces.size(), [&](size_t i) {
+        pieces[i].upper_count = (long long)count_uppercase(data + pieces[i].begin, (size_t)(pieces[i].end - pieces[i].begin));
+    });
+
+    vector<long long> upper_start(records.size() + 1, 0);
+    long long total = 0;
+    for (auto &p : pieces) {
+        p.upper_offset = total;
+        total += p.upper_count;
+        upper_start[p.record + 1] = total;
+    }
+    for (size_t r = 1; r <= records.size(); r++) upper_start[r] = max(upper_start[r], upper_start[r - 1]);
 
-        for (char c : line) {
-            if (isupper(c)) genome.push_back(c);
+    // 2. prolaz: velika slova izravno na njihovo mjesto u spojenoj sekvenci (za pakiranje),
+    // lowercase intervali i brojanje pozadine po komadu
+    string upper((size_t)total, '\0');
+    pool.parallel_for(pieces.size(), [&](size_t i) {
+        Piece &p = pieces[i];
+        char *out = &upper[0] + p.upper_offset;
+        SoftMaskState mask;
+        mask.pos = p.first_base + 1;
+
+        // komad počinje na početku linije, pa se obrađuje linija po linija
+        const char *line = data + p.begin;
+        const char *end = data + p.end;
+        while (line < end) {
+            const char *nl = static_cast<const char *>(memchr(line, '\n', (size_t)(end - line)));
+            if (nl == nullptr) nl = end;
+            out += scan_fasta_line(line, (size_t)(nl - line), out, mask, p.lowercase).upper;
+            line = nl + 1;
         }
+        mask.finish(p.lowercase);
+
+        p.counter = background.at(p.upper_offset);
+        p.counter.add(upper.data() + p.upper_offset, (size_t)p.upper_count);
+    });
+    for (const auto &p : pieces) background.merge(p.counter);
+
+    // pakiranje kromosoma u komadima od PACK_BASES baza
+    vector<PackedChromosome> packed(records.size());
+    vector<pair<size_t, long long>> pack_tasks;  // (zapis, prva baza)
+    for (size_t r = 0; r < records.size(); r++) {
+        packed[r].length = upper_start[r + 1] - upper_start[r];
+        packed[r].original_length = records[r]->length;
+        packed[r].packed.assign((size_t)((packed[r].length + 3) / 4), 0);
+        for (long long b = 0; b < packed[r].length; b += PACK_BASES) pack_tasks.push_back({r, b});
+    }
+
+    vector<vector<lowerCaseRegions>> task_n_runs(pack_tasks.size());
+    pool.parallel_for(pack_tasks.size(), [&](size_t i) {
+        size_t r = pack_tasks[i].first;
+        long long first = pack_tasks[i].second;
+        long long n = min(PACK_BASES, packed[r].length - first);
+        pack_bases(upper.data() + upper_start[r] + first, (size_t)n, first,
+                   packed[r].packed.data(), task_n_runs[i]);
+    });
+
+    for (size_t i = 0; i < pack_tasks.size(); i++) append_runs(packed[pack_tasks[i].first].n_runs, task_n_runs[i]);
+    for (const auto &p : pieces) append_runs(packed[p.record].lowercase, p.lowercase);
+
+    // zapis u spremnik redom kojim bi ih zapisao serijski prolaz
+    chromosome_lengths.assign(num_chromosomes, 0);
+    for (size_t r = 0; r < records.size(); r++) {
+        int chr = records[r]->chromosome;
+        chromosome_lengths[chr - 1] = (long)packed[r].length;
+        genome_store.write_chromosome(chr, packed[r]);
+        packed[r] = PackedChromosome();
     }
 
-    string cleaned;
-    cleaned.reserve(genome.size());
-    
-    for (const auto &r : coords) {
-        //PAZI: UCSC koordinate su 1-based, C++ je 0-based
-        for (int i = r.start - 1; i <= r.end - 1 && i < (int)genome.size(); i++) {
-            genome[i] = '\0';  // Postavljamo CpG otok na '\0' kako bi ga preskočili
+    for (int chr = 1; chr <= num_chromosomes; chr++) {
+        if (genome.find_chromosome(chr) == nullptr) {
+            cerr << "Upozorenje: kromosom " << chr << " nije pronađen u " << filename << endl;
         }
     }
+    return true;
+}
 
-    for (char c : genome) {
-        if (c != '\0') cleaned.push_back(c);
+
+void build_dinuc_caches(const string &output_dir, int num_chromosomes, ThreadPool &pool) {
+    GenomeStore store;
+    if (!store.open(output_dir + "/genome_store.bin")) {
+        cerr << "Ne mogu otvoriti spremnik genoma!" << endl;
+        exit(1);
+    }
+
+    vector<char> failed(num_chromosomes, 0);
+    pool.parallel_for((size_t)num_chromosomes, [&](size_t i) {
+        int chr = (int)i + 1;
+        const GenomeStoreEntry *e = store.entry(chr);
+        if (e == nullptr) return;
+
+        vector<uint8_t> O;
+        encode_dinucleotides(store.sequence(chr), O);
+        if (!write_dinuc_cache(dinuc_cache_path(output_dir, chr), chr, O, e->checksum)) failed[i] = 1;
+    });
+
+    for (int chr = 1; chr <= num_chromosomes; chr++) {
+        if (failed[chr - 1]) {
+            cerr << "Greška pri zapisivanju cache opažanja za kromosom " << chr << endl;
+            exit(1);
+        }
     }
-    return cleaned;
 }
 
 
 void open_output_files(
     int num_chromosomes, 
     const string &output_dir, 
-    vector<ofstream> &chromosome_out_files, 
+    GenomeStoreWriter &genome_store, 
     ofstream &out1, 
     ofstream &out2, 
     ofstream &coords_out
 ) {
 
-    chromosome_out_files.resize(num_chromosomes);
-    
-    for (int chr = 1; chr <= num_chromosomes; chr++) {
-        string chr_filename = output_dir + "/" + to_string(chr) + (chr <= 16 ? "_train_chr.txt" : "_test_chr.txt");
-        chromosome_out_files[chr - 1].open(chr_filename);
-        if (!chromosome_out_files[chr - 1]) {
-            cerr << "Greška pri otvaranju fajla za kromosom " << chr << endl;
-            exit(1);
-        }
+    if (!genome_store.open(output_dir + "/genome_store.bin", num_chromosomes)) {
+        cerr << "Greška pri otvaranju spremnika genoma!" << endl;
+        exit(1);
     }
 
     out1.open(output_dir + "/clean_positive.txt");
-    out2.open(output_dir + "/clean_background.txt");
+    out2.open(output_dir + "/background_counts.txt");
     coords_out.open(output_dir + "/coords.txt");
 
     if (!out1 || !out2 || !coords_out) {
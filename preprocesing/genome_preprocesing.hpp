@@ -4,65 +4,127 @@
 #include <string>
 #include <vector>
 #include <fstream>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
 
 #include "../utils/structs_consts_functions.hpp"
+#include "../genome/fasta_index.hpp"
+#include "../genome/genome_store.hpp"
+#include "../genome/dinuc_cache.hpp"
+#include "../genome/compressed_input.hpp"
+#include "../genome/fasta_scan.hpp"
+#include "../genome/annotation_index.hpp"
+#include "../genome/workspace_manifest.hpp"
+#include "../utils/thread_pool.hpp"
+#include "./background_counter.hpp"
 
 using namespace std;
 
 
 /**
- * Učitavanje pozitivnih CpG otoka iz FASTA fajla. Također parsira koordinate iz header linija
+ * Učitavanje pozitivnih CpG otoka iz FASTA fajla (nekomprimiranog, gzip ili BGZF). Također
+ * parsira koordinate iz header linija
  * Rezultat: vektor sekvenci CpG otoka i popunjen vektor koordinata coords.
  * 
  * @param filename - ime FASTA fajla
  * @param coords - referenca na vektor za pohranu koordinata
+ * @param threads - broj dretvi za BGZF dekompresiju (vidi open_input_stream)
  * 
  * @return vektor sekvenci CpG otoka
  */
-vector<string> load_positive_cpg(const string &filename, vector<CpgRegion> &coords);
+vector<string> load_positive_cpg(const string &filename, vector<CpgRegion> &coords, int threads = 1);
 
 
 /**
- * Učitava kromosom iz FASTA fajla, uključujući samo velika slova i ne čisti CpG otoke.
- * Također sprema raspone malih slova u genomu. Kromosome kasnije koristimo u Baum-Welch treningu.
- * 
+ * Dijeli genom na kromosome u jednom prolazu kroz FASTA fajl (nekomprimiran, gzip ili
+ * BGZF; BGZF blokovi se dekomprimiraju paralelno). Svaki zapis čiji header
+ * odgovara kromosomu 1..num_chromosomes zapisuje se u spremnik genoma: sekvenca (samo
+ * velika slova) pakirana na 2 bita po bazi i intervali malih slova (1-based).
+ * Ako se isti kromosom pojavi više puta, uzima se samo prvi zapis.
+ *
+ * U istom prolazu broje se i dinukleotidi pozadinskog genoma (velika slova svih kromosoma
+ * redom kako se pojavljuju u fajlu, bez CpG otoka; vidi BackgroundCounter), bez spremanja
+ * pozadine u memoriju, te se gradi samtools .fai indeks cijele FASTA datoteke.
+ *
  * @param filename Ime FASTA fajla
- * @param lowercaseCoords Referenca na vektor za pohranu koordinata malih slova
- * @param chr_number Broj kromosoma za učitavanje
- * 
- * @return string Sekvenca kromosoma
+ * @param num_chromosomes Broj kromosoma koji se izdvajaju
+ * @param genome_store Otvoreni spremnik genoma (vidi open_output_files)
+ * @param chromosome_lengths Izlazni vektor duljina (samo velika slova) po kromosomu
+ * @param background Brojač dinukleotida pozadine (izgrađen iz koordinata CpG otoka)
+ * @param fai_records Izlazni .fai indeks (prazan ako se datoteka ne može indeksirati
+ *                    ili je komprimirana)
+ * @param threads Broj dretvi za BGZF dekompresiju (vidi open_input_stream)
  */
-string load_chromosome(const string &filename, vector<lowerCaseRegions> &lowercaseCoords, int chr_number);
+void split_genome(
+    const string &filename,
+    int num_chromosomes,
+    GenomeStoreWriter &genome_store,
+    vector<long> &chromosome_lengths,
+    BackgroundCounter &background,
+    vector<FaiRecord> &fai_records,
+    int threads = 1
+);
 
 
 /**
- * Učitava genom oćišćen od CpG otoka i malih slova iz .txt doteteke.
- * Baziran je na koordinatama CpG otoka. Koristimo ga za inicijalizaciju početnog stanja HMM-a.
- * 
- * @param filename Ime doteteke
- * @param coords Vektor koordinata CpG otoka
- * 
- * @return string Sekvenca pozadinskog genoma
- * 
- * Napomena: Pretpostavlja se da je sekvenca već očišćena i spremna za upotrebu.
+ * Paralelna verzija split_genome za nekomprimirani genom. Preko .fai indeksa
+ * (GenomeProvider) dohvaća bajt raspon prvog zapisa svakog kromosoma u mapiranoj
+ * datoteci; veliki zapisi dijele se na komade poravnate na početak linije.
+ * Komadi se obrađuju paralelno u dva prolaza (brojanje velikih slova, pa zapis
+ * velikih slova izravno na njihovo mjesto u spojenoj sekvenci uz lowercase
+ * intervale i brojanje pozadine po komadu), nakon čega se kromosomi paralelno
+ * pakiraju i redom zapisuju u spremnik. Rezultat je identičan serijskom split_genome,
+ * ali za razliku od njega privremeno drži sva velika slova genoma u memoriji.
+ *
+ * @param filename Ime (nekomprimiranog) FASTA fajla
+ * @param num_chromosomes Broj kromosoma koji se izdvajaju
+ * @param genome_store Otvoreni spremnik genoma (vidi open_output_files)
+ * @param chromosome_lengths Izlazni vektor duljina (samo velika slova) po kromosomu
+ * @param background Brojač dinukleotida pozadine (izgrađen iz koordinata CpG otoka)
+ * @param pool Bazen dretvi
+ *
+ * @return false ako se datoteka ne može mapirati ili indeksirati (ili ima "\r\n"
+ *         linije); tada ništa nije zapisano i treba koristiti split_genome
+ */
+bool split_genome_parallel(
+    const string &filename,
+    int num_chromosomes,
+    GenomeStoreWriter &genome_store,
+    vector<long> &chromosome_lengths,
+    BackgroundCounter &background,
+    ThreadPool &pool
+);
+
+
+/**
+ * Gradi cache dinukleotidnih opažanja (<chr>_dinuc.bin) za svaki kromosom iz
+ * zapisanog spremnika genoma, kako train i decode faza ne bi ponovno kodirale sekvencu.
+ *
+ * Kromosomi su neovisni pa se cache datoteke grade paralelno.
+ *
+ * @param output_dir Direktorij s genome_store.bin u koji se zapisuju cache datoteke
+ * @param num_chromosomes Broj kromosoma
+ * @param pool Bazen dretvi
  */
-string load_background(const string &filename, const vector<CpgRegion> &coords);
+void build_dinuc_caches(const string &output_dir, int num_chromosomes, ThreadPool &pool);
 
 
 /**
- * Otvara izlazne fajlove za svaki kromosom, pozitivne CpG otoke, pozadinski genom i koordinate
+ * Otvara spremnik genoma (genome_store.bin) i izlazne fajlove za pozitivne CpG otoke,
+ * brojeve dinukleotida pozadine i koordinate
  * 
  * @param num_chromosomes Broj kromosoma
  * @param output_dir Direktorij za izlazne fajlove
- * @param chromosome_out_files Referenca na vektor ofstream objekata za kromosome
+ * @param genome_store Referenca na spremnik genoma za kromosome
  * @param out1 Referenca na ofstream za pozitivne CpG otoke
- * @param out2 Referenca na ofstream za pozadinski genom
+ * @param out2 Referenca na ofstream za brojeve dinukleotida pozadine
  * @param coords_out Referenca na ofstream za koordinate CpG otoka
  */
 void open_output_files(
     int num_chromosomes, 
     const string &output_dir, 
-    vector<ofstream> &chromosome_out_files, 
+    GenomeStoreWriter &genome_store, 
     ofstream &out1, 
     ofstream &out2, 
     ofstream &coords_out
@@ -1,65 +1,40 @@
 #include "./train_func.hpp"
 
 
-void get_chromosome_and_lowercase_regions(const string& filename, string& seq, vector<lowerCaseRegions>& lc) {
-    ifstream in(filename);
-    if (!in) {
-        cerr << "Ne mogu otvoriti: " << filename << endl;
-        exit(1);
-    }
-
-    getline(in, seq);
-    int s, e;
-    while (in >> s >> e) {
-        lc.push_back({s, e});
-    }
-}
-
-
-vector<int> seq_to_dinuc(const string& s, int start, int end) {
-    vector<int> O;
-    int L = end - start + 1;
-
-    if (L < 2) return O;
-
-    O.reserve(L - 1);
-    for (int pos = start + 1; pos <= end; pos++) {
-        char prev = s[(size_t)(pos - 2)]; 
-        char cur  = s[(size_t)(pos - 1)]; 
-        int x = di_index(prev, cur);
-        if (x != -1) O.push_back(x);
-    }
-
-    return O;
-}
-
-
-int map_to_comp(const vector<lowerCaseRegions>& lc, int orig_pos) {
-    long long removed = 0;
-
-    for (const auto& r : lc) {
-        if (r.start >= orig_pos) break;
-        int end = min(r.end, orig_pos - 1);
-        if (end >= r.start) {
-            removed += (end - r.start + 1);
-        }
-    }
-
-    return orig_pos - removed;
+void get_chromosome_and_lowercase_regions(
+    const string& filename,
+    int chr,
+    GenomeStore& store,
+    PackedSequence& seq,
+    vector<lowerCaseRegions>& lc
+) {
+    open_genome_store_or_exit(filename, store, chr);
+    seq = store.sequence(chr);
+    lc = store.lowercase_regions(chr);
 }
 
 
 vector<CpgRegion> map_orig_coords_to_compressed(
-    const string& seq,
-    const vector<lowerCaseRegions>& lc,
+    const PackedSequence& seq,
+    const CoordinateMap& map,
     const vector<CpgRegion>& orig_coords
 ) {
     vector<CpgRegion> comp_coords;
     comp_coords.reserve(orig_coords.size());
 
+    // start i end svih otoka redom, pa je ulaz u skupno preslikavanje (gotovo) sortiran
+    vector<long long> positions;
+    positions.reserve(2 * orig_coords.size());
     for (const auto& r : orig_coords) {
-        int c_start = map_to_comp(lc, r.start);
-        int c_end = map_to_comp(lc, r.end);
+        positions.push_back(r.start);
+        positions.push_back(r.end);
+    }
+    map.to_compressed(positions);
+
+    for (size_t i = 0; i < orig_coords.size(); i++) {
+        const CpgRegion& r = orig_coords[i];
+        int c_start = (int)positions[2 * i];
+        int c_end = (int)positions[2 * i + 1];
         if (c_start < 1) c_start = 1;
         if (c_end > (int)seq.size()) c_end = (int)seq.size();
         if (c_start <= c_end) {
@@ -72,13 +47,15 @@ vector<CpgRegion> map_orig_coords_to_compressed(
 
 
 void build_masked_sequences(
-    const string& s,
+    const PackedSequence& s,
+    ObsView O_all,
     const vector<CpgRegion>& coords_chr,
-    vector<vector<int>>& sequences,
-    vector<vector<array<double, NSTATE>>>& masks
+    vector<ObsView>& sequences,
+    vector<uint8_t>& mask_all,
+    vector<MaskView>& masks,
+    int chunk_d
 ) {
     const int NEG_MARGIN = 200;
-    const int CHUNK_D = 1'000'000;
 
     /*
      * 1. Priprema pomoćnih nizova po bazama
@@ -109,47 +86,63 @@ void build_masked_sequences(
     /*
      * 2. Chunkiranje sekvence
      *
-     * HMM opažanja su dinukleotidi, pa je ukupan broj opažanja: T_full = |s| - 1
+     * HMM opažanja su dinukleotidi, pa je ukupan broj opažanja: T_full = |s| - 1.
+     * Dinukleotidi koji dodiruju N-regiju nemaju opažanje, pa se sekvenca dijeli
+     * na dijelove bez N-regija, a svaki dio na granicama mreže od chunk_d dinukleotida.
     */
     int T_full = int(s.size()) - 1;
+    mask_all.assign(O_all.size(), MASK_BOTH);
+
+    long long obs_start = 0;     // indeks opažanja prvog dinukleotida dijela
+    long long run_start = 0;     // prvi dinukleotid dijela bez N-regije
+    for (size_t k = 0; k <= s.n_run_count; k++) {
+        // N-regija [a, b] (1-based baze) poništava dinukleotide [a - 2, b - 1]
+        long long run_end = T_full;
+        long long next_start = T_full;
+        if (k < s.n_run_count) {
+            run_end = max(0LL, (long long)s.n_runs[k].start - 2);
+            next_start = min((long long)T_full, (long long)s.n_runs[k].end);
+        }
 
-    for (int start_d = 0; start_d < T_full; start_d += CHUNK_D) {
-        int end_d = min(start_d + CHUNK_D, T_full);
-
-        // odrđivanje dinukleotida u chunku
-        int start_bp = start_d + 1;
-        int end_bp = end_d + 1;
-        auto O = seq_to_dinuc(s, start_bp, end_bp);
-        if (O.size() < 2) continue;
-
-        vector<array<double, NSTATE>> mask;
-        mask.reserve(O.size());
-
-
-        /* 3. Izgradnja maske dozvoljenih stanja po dinukleotidu */
-        for (int d = start_d; d < end_d; d++) {
-            int b1 = d + 1;
-            int b2 = d + 2;
-            if (b2 > (int)s.size()) break;
-
-            // Ako je barem jedna baza unutar CpG regije -> CpG stanje
-            if (base_is_cpg[b1] || base_is_cpg[b2]) {
-                mask.push_back({0.0, 1.0});
-            
-            // Ako je dinukleotid daleko od svih CpG regija -> non-CpG
-            } else if (!base_near_cpg[b1] && !base_near_cpg[b2]) {
-                mask.push_back({1.0, 0.0});
-
-            // Prijelazna zona
-            } else {
-                mask.push_back({1.0, 1.0});
+        for (long long start_d = run_start; start_d < run_end; ) {
+            long long end_d = min(run_end, (start_d / chunk_d + 1) * chunk_d);
+            ObsView O = O_all.sub((size_t)obs_start, (size_t)(end_d - start_d));
+            uint8_t* mask = mask_all.data() + obs_start;
+            obs_start += end_d - start_d;
+
+            if (O.size() >= 2) {
+                /* 3. Izgradnja maske dozvoljenih stanja po dinukleotidu */
+                size_t filled = 0;
+                for (long long d = start_d; d < end_d; d++) {
+                    int b1 = (int)d + 1;
+                    int b2 = (int)d + 2;
+
+                    // Ako je barem jedna baza unutar CpG regije -> CpG stanje
+                    if (base_is_cpg[b1] || base_is_cpg[b2]) {
+                        mask[filled++] = MASK_CPG;
+
+                    // Ako je dinukleotid daleko od svih CpG regija -> non-CpG
+                    } else if (!base_near_cpg[b1] && !base_near_cpg[b2]) {
+                        mask[filled++] = MASK_B;
+
+                    // Prijelazna zona
+                    } else {
+                        mask[filled++] = MASK_BOTH;
+                    }
+                }
+
+                sequences.push_back(O);
+                masks.push_back(MaskView(mask, filled));
             }
+            start_d = end_d;
         }
+        run_start = max(run_start, next_start);
+    }
 
-        // provjera ima li svaki dinukleoid jednu masku
-        if (mask.size() == O.size()) {
-            sequences.push_back(move(O));
-            masks.push_back(move(mask));
-        }
+    // provjera ima li svaki dinukleotid jedno opažanje
+    if (obs_start != (long long)O_all.size()) {
+        cerr << "Broj opažanja (" << O_all.size() << ") ne odgovara sekvenci bez N-regija ("
+             << obs_start << ")" << endl;
+        exit(1);
     }
 }
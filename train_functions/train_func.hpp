@@ -9,43 +9,30 @@
 #include <algorithm>
 
 #include "../utils/structs_consts_functions.hpp"
+#include "../genome/genome_store.hpp"
+#include "../genome/dinuc_cache.hpp"
+#include "../genome/coordinate_map.hpp"
 
 using namespace std;
 
 
 /**
- * @brief Ucitava sekvencu + lowercase intervale iz *_train_chr fajla.
+ * @brief Mapira spremnik genoma i ucitava lowercase intervale kromosoma. Sekvenca se
+ * ne kopira, seq pokazuje izravno u mapirani spremnik (vrijedi dok postoji store).
  * 
- * @param filename Putanja do fajla.
- * @param seq Referenca na string u koji se učitava sekvenca.
+ * @param filename Putanja do spremnika genoma.
+ * @param chr Broj kromosoma.
+ * @param store Referenca na spremnik koji se otvara.
+ * @param seq Referenca na pogled na pakiranu sekvencu kromosoma.
  * @param lc Referenca na vektor lowercase regija koje se učitavaju.
  */
-void get_chromosome_and_lowercase_regions(const string& filename, string& seq, vector<lowerCaseRegions>& lc);
-
-
-/**
- * @brief Pretvara sekvencu kromosoma u dinukleotidna opažanja i sprema
- * ih kao vrijednosti [1, 16] u vektor O. Pogledaj funkciju di_index u 
- * structs_consts_functions.hpp za mapiranje dinukleotida na indekse.
- * 
- * @param s Sekvenca kromosoma (1-based indeksi).
- * @param start Početna pozicija (1-based).
- * @param end Završna pozicija (1-based).
- * 
- * @return Vektor dinukleotidnih opažanja.
- */
-vector<int> seq_to_dinuc(const string& s, int start, int end);
-
-
-/**
- * @brief Mapira original 1-based start/end coord -> komprimirana 1-based start/end coord (uppercase-only)
- * 
- * @param lc Vektor lowercase regija.
- * @param orig_pos Originalna 1-based pozicija.
- * 
- * @return Komprimirana 1-based pozicija.
- */
-int map_orig_to_comp(const vector<lowerCaseRegions>& lc, int orig_pos);
+void get_chromosome_and_lowercase_regions(
+    const string& filename,
+    int chr,
+    GenomeStore& store,
+    PackedSequence& seq,
+    vector<lowerCaseRegions>& lc
+);
 
 
 /**
@@ -54,18 +41,24 @@ int map_orig_to_comp(const vector<lowerCaseRegions>& lc, int orig_pos);
  * lowercase regijama, kako bi se dobile koordinate u komprimiranoj sekvenci.
  *
  * @param seq Komprimirana sekvenca kromosoma (samo uppercase).
- * @param lc Vektor lowercase regija.
+ * @param map Mapa koordinata kromosoma (izgrađena iz lowercase regija).
  * @param orig_coords Vektor originalnih koordinata CpG otoka.
  * 
  * @return Vektor koordinata CpG otoka u komprimiranoj sekvenci.
  */
 vector<CpgRegion> map_orig_coords_to_compressed(
-    const string& seq,
-    const vector<lowerCaseRegions>& lc,
+    const PackedSequence& seq,
+    const CoordinateMap& map,
     const vector<CpgRegion>& orig_coords
 );
 
 
+/**
+ * Zadana duljina trening chunka (dinukleotidi).
+ */
+constexpr int TRAIN_CHUNK_D = 1'000'000;
+
+
 /**
  * Izgrađuje trening sekvence dinukleotida i pripadajuće maske dozvoljenih HMM stanja
  * za semi-supervizirano treniranje CpG HMM-a.
@@ -85,15 +78,22 @@ vector<CpgRegion> map_orig_coords_to_compressed(
  * Zbog memorijskih i računalnih ograničenja, sekvenca se dijeli u nezavisne
  * chunkove fiksne maksimalne duljine (izražene u broju dinukleotida).
  * Svaki chunk se tretira kao zasebna trening sekvenca u Baum–Welch algoritmu.
+ * Chunkovi se režu i na N-regijama, pa je svaki dio bez N-regija zasebna sekvenca.
  *
  * @param s Uppercase DNA sekvenca kromosoma (1-based indeksiranje se koristi logički).
+ * @param O_all Dinukleotidna opažanja cijelog kromosoma (vidi DinucCache).
  * @param coords_chr Koordinate poznatih CpG regija, mapirane u komprimirani prostor.
- * @param sequences Izlazni vektor dinukleotidnih opažanja (jedan vektor po chunku).
- * @param masks Izlazni vektor maski dozvoljenih stanja (paralelan s `sequences`).
+ * @param sequences Izlazni vektor dinukleotidnih opažanja (jedan pogled u O_all po chunku).
+ * @param mask_all Izlazni spremnik maski za cijeli kromosom (jedan bajt po opažanju, paralelan s O_all).
+ * @param masks Izlazni vektor maski dozvoljenih stanja (jedan pogled u mask_all po chunku, paralelan s `sequences`).
+ * @param chunk_d Najveća duljina chunka (dinukleotidi); chunk se reže na N-regijama.
  */
 void build_masked_sequences(
-    const string& s,
+    const PackedSequence& s,
+    ObsView O_all,
     const vector<CpgRegion>& coords_chr,
-    vector<vector<int>>& sequences,
-    vector<vector<array<double, NSTATE>>>& masks
+    vector<ObsView>& sequences,
+    vector<uint8_t>& mask_all,
+    vector<MaskView>& masks,
+    int chunk_d = TRAIN_CHUNK_D
 );
\ No newline at end of file
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+
+
+/**
+ * Brzi 64-bitni kontrolni zbroj (nije kriptografski) za provjeru integriteta
+ * binarnih datoteka iz predobrade. Podaci se mogu dodavati u dijelovima,
+ * rezultat ovisi samo o nizu bajtova, ne o načinu podjele.
+ */
+class Checksum64 {
+public:
+    void update(const void* data, size_t n) {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        total += n;
+
+        if (buf_len > 0) {
+            size_t take = (n < 8 - buf_len) ? n : 8 - buf_len;
+            memcpy(buf + buf_len, p, take);
+            buf_len += take;
+            p += take;
+            n -= take;
+            if (buf_len < 8) return;
+            mix(load(buf));
+            buf_len = 0;
+        }
+
+        while (n >= 8) {
+            mix(load(p));
+            p += 8;
+            n -= 8;
+        }
+
+        memcpy(buf, p, n);
+        buf_len = n;
+    }
+
+    uint64_t value() const {
+        Checksum64 c = *this;
+        if (c.buf_len > 0) {
+            memset(c.buf + c.buf_len, 0, 8 - c.buf_len);
+            c.mix(load(c.buf));
+        }
+        c.mix(total);
+
+        uint64_t x = c.h;
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+        return x;
+    }
+
+private:
+    static uint64_t load(const uint8_t* p) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        return w;
+    }
+
+    void mix(uint64_t w) {
+        h ^= w * 0x87c37b91114253d5ULL;
+        h = ((h << 31) | (h >> 33)) * 0x9E3779B97F4A7C15ULL;
+    }
+
+    uint64_t h = 0x9E3779B97F4A7C15ULL;
+    uint64_t total = 0;
+    uint8_t buf[8] = {0};
+    size_t buf_len = 0;
+};
+
+
+/**
+ * @brief Kontrolni zbroj cijelog bloka memorije.
+ */
+inline uint64_t checksum64(const void* data, size_t n) {
+    Checksum64 c;
+    c.update(data, n);
+    return c.value();
+}
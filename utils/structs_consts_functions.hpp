@@ -1,5 +1,10 @@
 #pragma once
 
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <utility>
+
 
 /**
  * Globalne konstante HMM-a
@@ -20,20 +25,39 @@ constexpr int NSYM   = 16;
 
 
 /**
- * Struktura za pohranu HMM parametara
+ * Struktura za pohranu parametara HMM-a sa S stanja i K emisijskih simbola
  *
  * A[i][j]  - prijelazna vjerojatnost iz stanja i u stanje j
- * B[i][k]  - emisijska vjerojatnost stanja i za za dinukleotid k (0..15)
+ * B[i][k]  - emisijska vjerojatnost stanja i za simbol k (0..K-1)
  * pi[i]    - inicijalna vjerojatnost stanja i
  * chromosome označava kromosom na kojem je model zadnje treniran
+ *
+ * HMM je CpG model s NSTATE stanja i NSYM dinukleotidnih simbola; veći modeli
+ * (npr. 8 stanja po nukleotidu ili trinukleotidni kontekst) koriste isti
+ * predložak s algorithms/hmm_engine.hpp.
  */
-struct HMM {
-    double A[NSTATE][NSTATE];
-    double B[NSTATE][NSYM];
-    double pi[NSTATE];
+template <int S, int K>
+struct HMMParams {
+    static constexpr int states = S;
+    static constexpr int symbols = K;
+
+    double A[S][S];
+    double B[S][K];
+    double pi[S];
     int chromosome;
 };
 
+typedef HMMParams<NSTATE, NSYM> HMM;
+
+
+/**
+ * Pretvara bazu u indeks 0..3: A=0, C=1, G=2, T=3.
+ * Vraća -1 ako znak nije A/C/G/T.
+ */
+inline int base_index(char c) {
+    return (c=='A')?0:(c=='C')?1:(c=='G')?2:(c=='T')?3:-1;
+}
+
 
 /**
  * Pretvara dinukleotid (prev, cur) u indeks 0..15:
@@ -45,10 +69,8 @@ struct HMM {
  * Vraća -1 ako bilo koji znak nije A/C/G/T.
  */
 inline int di_index(char a, char b) {
-    int x =
-        (a=='A')?0:(a=='C')?1:(a=='G')?2:(a=='T')?3:-1;
-    int y =
-        (b=='A')?0:(b=='C')?1:(b=='G')?2:(b=='T')?3:-1;
+    int x = base_index(a);
+    int y = base_index(b);
     return (x < 0 || y < 0) ? -1 : (x << 2) | y; // doslovno x*4+y
 }
 
@@ -78,3 +100,59 @@ struct lowerCaseRegions {
     int start;
     int end;
 };
+
+
+/**
+ * Pogled na kontinuirani niz elemenata tipa T bez kopiranja.
+ * Može pokazivati na vektor, std::array, mapiranu datoteku ili dio drugog
+ * pogleda (npr. prozor ili chunk); pogled ne posjeduje memoriju.
+ */
+template <typename T>
+struct SeqView {
+    const T* ptr = nullptr;
+    size_t len = 0;
+
+    SeqView() = default;
+    SeqView(const T* p, size_t n) : ptr(p), len(n) {}
+
+    // bilo koji kontinuirani izvor s data() i size() (vector, array, string...)
+    template <typename C, typename = decltype(static_cast<const T*>(std::declval<const C&>().data()))>
+    SeqView(const C& c) : ptr(c.data()), len(c.size()) {}
+
+    size_t size() const { return len; }
+    bool empty() const { return len == 0; }
+    const T& operator[](size_t i) const { return ptr[i]; }
+    const T* begin() const { return ptr; }
+    const T* end() const { return ptr + len; }
+
+    /**
+     * @brief Pod-pogled [start, start + count).
+     */
+    SeqView sub(size_t start, size_t count) const { return SeqView(ptr + start, count); }
+};
+
+
+/**
+ * Pogled na niz dinukleotidnih opažanja (indeksi 0..15), jedan bajt po opažanju.
+ */
+typedef SeqView<uint8_t> ObsView;
+
+
+/**
+ * Maska dozvoljenih stanja po t, jedan bajt po opažanju: bit j je postavljen
+ * ako je stanje j dozvoljeno (do 8 stanja). MASK_B / MASK_CPG / MASK_BOTH su
+ * vrijednosti za CpG model.
+ */
+typedef SeqView<uint8_t> MaskView;
+
+constexpr uint8_t MASK_B    = 1;
+constexpr uint8_t MASK_CPG  = 2;
+constexpr uint8_t MASK_BOTH = 3;
+
+
+/**
+ * @brief Vrijednost maske (0.0 ili 1.0) za stanje j.
+ */
+inline double mask_allows(uint8_t m, int j) {
+    return (double)((m >> j) & 1);
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+
+/**
+ * Jednostavan bazen dretvi s FIFO redom zadataka.
+ *
+ * submit() vraća std::future s rezultatom zadatka, a parallel_for() dijeli
+ * raspon indeksa dinamički: dretve redom uzimaju sljedeći slobodni blok
+ * indeksa, pa brže dretve obrade više blokova (balansiranje opterećenja).
+ */
+class ThreadPool {
+public:
+    /**
+     * @param threads Broj dretvi; 0 znači std::thread::hardware_concurrency()
+     */
+    explicit ThreadPool(int threads = 0) {
+        if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+        if (threads <= 0) threads = 1;
+
+        for (int i = 0; i < threads; i++) {
+            workers.emplace_back([this] { worker_loop(); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (auto& w : workers) w.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return (int)workers.size(); }
+
+    template <class F>
+    auto submit(F f) -> std::future<decltype(f())> {
+        using R = decltype(f());
+        auto task = std::make_shared<std::packaged_task<R()>>(std::move(f));
+        std::future<R> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push([task] { (*task)(); });
+        }
+        cv.notify_one();
+        return result;
+    }
+
+    /**
+     * @brief Poziva f(i) za svaki i u [0, n). Indeksi se dijele u blokove od grain
+     * uzastopnih indeksa koje dretve dinamički preuzimaju. Vraća se kad su svi
+     * pozivi završeni; prva iznimka iz f se prosljeđuje pozivatelju.
+     */
+    template <class F>
+    void parallel_for(size_t n, F f, size_t grain = 1) {
+        if (n == 0) return;
+        if (grain == 0) grain = 1;
+
+        auto next = std::make_shared<std::atomic<size_t>>(0);
+        size_t blocks = (n + grain - 1) / grain;
+        size_t runners = std::min(blocks, (size_t)size());
+
+        std::vector<std::future<void>> done;
+        done.reserve(runners);
+        for (size_t r = 0; r < runners; r++) {
+            done.push_back(submit([next, n, grain, &f] {
+                for (;;) {
+                    size_t start = next->fetch_add(grain);
+                    if (start >= n) break;
+                    size_t end = std::min(n, start + grain);
+                    for (size_t i = start; i < end; i++) f(i);
+                }
+            }));
+        }
+
+        // čekamo sve dretve prije prosljeđivanja iznimke jer koriste referencu na f
+        std::exception_ptr error;
+        for (auto& d : done) {
+            try {
+                d.get();
+            } catch (...) {
+                if (!error) error = std::current_exception();
+            }
+        }
+        if (error) std::rethrow_exception(error);
+    }
+
+private:
+    void worker_loop() {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty()) return;
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopping = false;
+};
+
+
+/**
+ * @brief Čita opciju "--threads N" (ili drugu opciju s brojem dretvi) iz
+ * argumenata naredbenog retka. Druge opcije se ignoriraju; neispravna
+ * vrijednost prekida program.
+ *
+ * @param default_threads Broj dretvi ako opcija nije zadana
+ * @param option Naziv opcije
+ * @return Broj dretvi (barem 1)
+ */
+inline int parse_threads_option(int argc, char* argv[], int default_threads = 1, const char* option = "--threads") {
+    int threads = default_threads;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], option) != 0) continue;
+
+        char* end = nullptr;
+        long n = (i + 1 < argc) ? std::strtol(argv[i + 1], &end, 10) : 0;
+        if (end == nullptr || *end != '\0' || n < 1 || n > 1024) {
+            std::cerr << "Neispravan broj dretvi za " << option << std::endl;
+            std::exit(1);
+        }
+        threads = (int)n;
+        i++;
+    }
+    return threads;
+}